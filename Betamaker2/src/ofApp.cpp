@@ -220,7 +220,7 @@ void ofApp::update()
                 plot1->update(newData[i].values[0]);
                 //plot2->update(newData[i].values[6] - newData[i].values[5]);
                 
-                timeslice.push_back(newData[i].values[0]*.02232);
+                timeslice.push_back(newData[i].values[0]*COUNT_TO_MICROVOLT);
                 if (timeslice.size()>1 && timeslice.size()%256==0)
                 {
                     
@@ -79,4 +79,33 @@ double ofxInlineFilter::update(float input){
     return x;
 }
 
+void ofxInlineFilter::process(const float* in, float* out, size_t numSamples, size_t stride){
+    if (!isSetup) {
+        printf("ERROR: Need to call setup() to initialize this filter");
+        return;
+    }
+    
+    //update() feeds the input to every section and returns the last one's
+    //output, so the sections can run one after the other over the block.
+    //Only the last one writes, after the others are done reading in.
+    int sections = (int)ceil(n);
+    for(int i=0; i<sections; ++i){
+        double a = A[i], c1 = d1[i], c2 = d2[i], c3 = d3[i], c4 = d4[i];
+        double s0 = w0[i], s1 = w1[i], s2 = w2[i], s3 = w3[i], s4 = w4[i];
+        bool last = (i == sections-1);
+        
+        for(size_t t=0; t<numSamples; ++t){
+            s0 = c1*s1 + c2*s2+ c3*s3+ c4*s4 + (double)in[t*stride];
+            double x = a*(s0 - 2.0*s2 + s4);
+            s4 = s3;
+            s3 = s2;
+            s2 = s1;
+            s1 = s0;
+            if (last)
+                out[t*stride] = (float)x;
+        }
+        
+        w0[i] = s0; w1[i] = s1; w2[i] = s2; w3[i] = s3; w4[i] = s4;
+    }
+}
     
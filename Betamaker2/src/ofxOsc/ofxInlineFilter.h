@@ -19,6 +19,13 @@ public:
 
     ofxInlineFilter();
     double update(float input);
+
+    //Filters n samples read from in[i*stride] into out[i*stride], in == out
+    //is fine. The state stays in locals for the whole block. Each output is
+    //exactly (float)update(in[i*stride]), as long as the compiler doesn't
+    //fuse the multiply-adds differently in the two loops (then within ~1e-7
+    //relative, the float rounding of the output).
+    void process(const float* in, float* out, size_t n, size_t stride = 1);
     void setup(float nPoles, float samplingRate, float freqLowBand, float freqHighBand);
 
     
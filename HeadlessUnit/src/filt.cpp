@@ -40,10 +40,29 @@
 #include "filt.h"
 #define ECODE(x) {m_error_flag = x; return;}
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#if defined(__FMA__)
+#define FILT_MADD(a, b, c) _mm256_fmadd_pd(a, b, c)
+#else
+#define FILT_MADD(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#endif
+static inline double filt_hsum(__m256d v)
+{
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 // Handles LPF and HPF case
 Filter::Filter(filterType filt_t, int num_taps, double Fs, double Fx)
 {
 	m_error_flag = 0;
+	m_fft_threshold = m_fft_len = m_fft_block = m_fft_fill = 0;
 	m_filt_t = filt_t;
 	m_num_taps = num_taps;
 	m_Fs = Fs;
@@ -56,7 +75,7 @@ Filter::Filter(filterType filt_t, int num_taps, double Fs, double Fx)
 
 	m_taps = m_sr = NULL;
 	m_taps = (double*)malloc( m_num_taps * sizeof(double) );
-	m_sr = (double*)malloc( m_num_taps * sizeof(double) );
+	m_sr = (double*)malloc( 2 * m_num_taps * sizeof(double) );
 	if( m_taps == NULL || m_sr == NULL ) ECODE(-4);
 	
 	init();
@@ -64,6 +83,7 @@ Filter::Filter(filterType filt_t, int num_taps, double Fs, double Fx)
 	if( m_filt_t == LPF ) designLPF();
 	else if( m_filt_t == HPF ) designHPF();
 	else ECODE(-5);
+	find_symmetry();
 
 	return;
 }
@@ -73,6 +93,7 @@ Filter::Filter(filterType filt_t, int num_taps, double Fs, double Fl,
                double Fu)
 {
 	m_error_flag = 0;
+	m_fft_threshold = m_fft_len = m_fft_block = m_fft_fill = 0;
 	m_filt_t = filt_t;
 	m_num_taps = num_taps;
 	m_Fs = Fs;
@@ -89,13 +110,14 @@ Filter::Filter(filterType filt_t, int num_taps, double Fs, double Fl,
 
 	m_taps = m_sr = NULL;
 	m_taps = (double*)malloc( m_num_taps * sizeof(double) );
-	m_sr = (double*)malloc( m_num_taps * sizeof(double) );
+	m_sr = (double*)malloc( 2 * m_num_taps * sizeof(double) );
 	if( m_taps == NULL || m_sr == NULL ) ECODE(-15);
 	
 	init();
 
 	if( m_filt_t == BPF ) designBPF();
 	else ECODE(-16);
+	find_symmetry();
 
 	return;
 }
@@ -104,6 +126,7 @@ Filter::~Filter()
 {
 	if( m_taps != NULL ) free( m_taps );
 	if( m_sr != NULL ) free( m_sr );
+	free_fft();
 }
 
 void 
@@ -232,6 +255,19 @@ Filter::write_freqres_to_file( char *filename )
 	return 0;
 }
 
+void 
+Filter::find_symmetry()
+{
+	int n;
+
+	m_symmetric = 1;
+	for(n = 0; n < m_num_taps / 2; n++){
+		if( m_taps[n] != m_taps[m_num_taps - 1 - n] ) m_symmetric = 0;
+	}
+
+	return;
+}
+
 void 
 Filter::init()
 {
@@ -239,26 +275,225 @@ Filter::init()
 
 	if( m_error_flag != 0 ) return;
 
-	for(i = 0; i < m_num_taps; i++) m_sr[i] = 0;
+	for(i = 0; i < 2 * m_num_taps; i++) m_sr[i] = 0;
+	m_pos = 0;
+
+#ifdef ENABLE_FFTW
+	if( m_fft_len ){
+		for(i = 0; i < m_fft_len; i++) m_fft_in[i] = m_fft_out[i] = 0;
+		m_fft_fill = 0;
+	}
+#endif
 
 	return;
 }
 
+// Sum of m_taps[k] * (k-th newest sample). Linear phase taps are paired up,
+// taps[k] * (x[k] + x[N-1-k]), which halves the multiplies.
+double 
+Filter::dot_window()
+{
+	const double *x = m_sr + m_pos;
+	const double *h = m_taps;
+	int n = m_num_taps;
+	int half = n / 2;
+	int k = 0;
+	double result = 0;
+
+	if( m_symmetric ){
+#if defined(__AVX2__)
+		__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+		for(; k + 8 <= half; k += 8){
+			// x[n-4-k..n-1-k] loaded forwards, then reversed to line up with x[k..k+3]
+			__m256d r0 = _mm256_permute4x64_pd(_mm256_loadu_pd(x + n - 4 - k), _MM_SHUFFLE(0,1,2,3));
+			__m256d r1 = _mm256_permute4x64_pd(_mm256_loadu_pd(x + n - 8 - k), _MM_SHUFFLE(0,1,2,3));
+			acc0 = FILT_MADD(_mm256_loadu_pd(h + k), _mm256_add_pd(_mm256_loadu_pd(x + k), r0), acc0);
+			acc1 = FILT_MADD(_mm256_loadu_pd(h + k + 4), _mm256_add_pd(_mm256_loadu_pd(x + k + 4), r1), acc1);
+		}
+		result = filt_hsum(_mm256_add_pd(acc0, acc1));
+#elif defined(__SSE2__)
+		__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+		for(; k + 4 <= half; k += 4){
+			__m128d r0 = _mm_loadu_pd(x + n - 2 - k), r1 = _mm_loadu_pd(x + n - 4 - k);
+			r0 = _mm_shuffle_pd(r0, r0, 1);
+			r1 = _mm_shuffle_pd(r1, r1, 1);
+			acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(h + k), _mm_add_pd(_mm_loadu_pd(x + k), r0)));
+			acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(h + k + 2), _mm_add_pd(_mm_loadu_pd(x + k + 2), r1)));
+		}
+		acc0 = _mm_add_pd(acc0, acc1);
+		result = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		float64x2_t acc0 = vdupq_n_f64(0), acc1 = vdupq_n_f64(0);
+		for(; k + 4 <= half; k += 4){
+			float64x2_t r0 = vextq_f64(vld1q_f64(x + n - 2 - k), vld1q_f64(x + n - 2 - k), 1);
+			float64x2_t r1 = vextq_f64(vld1q_f64(x + n - 4 - k), vld1q_f64(x + n - 4 - k), 1);
+			acc0 = vfmaq_f64(acc0, vld1q_f64(h + k), vaddq_f64(vld1q_f64(x + k), r0));
+			acc1 = vfmaq_f64(acc1, vld1q_f64(h + k + 2), vaddq_f64(vld1q_f64(x + k + 2), r1));
+		}
+		result = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+		for(; k < half; k++) result += h[k] * (x[k] + x[n - 1 - k]);
+		if( n & 1 ) result += h[half] * x[half];
+		return result;
+	}
+
+#if defined(__AVX2__)
+	__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+	for(; k + 8 <= n; k += 8){
+		acc0 = FILT_MADD(_mm256_loadu_pd(h + k), _mm256_loadu_pd(x + k), acc0);
+		acc1 = FILT_MADD(_mm256_loadu_pd(h + k + 4), _mm256_loadu_pd(x + k + 4), acc1);
+	}
+	result = filt_hsum(_mm256_add_pd(acc0, acc1));
+#elif defined(__SSE2__)
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	for(; k + 4 <= n; k += 4){
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(h + k), _mm_loadu_pd(x + k)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(h + k + 2), _mm_loadu_pd(x + k + 2)));
+	}
+	acc0 = _mm_add_pd(acc0, acc1);
+	result = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	float64x2_t acc0 = vdupq_n_f64(0), acc1 = vdupq_n_f64(0);
+	for(; k + 4 <= n; k += 4){
+		acc0 = vfmaq_f64(acc0, vld1q_f64(h + k), vld1q_f64(x + k));
+		acc1 = vfmaq_f64(acc1, vld1q_f64(h + k + 2), vld1q_f64(x + k + 2));
+	}
+	result = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+	for(; k < n; k++) result += h[k] * x[k];
+	return result;
+}
+
 double 
 Filter::do_sample(double data_sample)
 {
-	int i;
+	if( m_error_flag != 0 ) return(0);
+	if( m_fft_len ) return fft_sample(data_sample);
+
+	// Step back one slot and write both copies, the window m_sr[m_pos..]
+	// then runs newest to oldest
+	m_pos = (m_pos == 0) ? m_num_taps - 1 : m_pos - 1;
+	m_sr[m_pos] = m_sr[m_pos + m_num_taps] = data_sample;
+
+	return dot_window();
+}
+
+void
+Filter::process(const float *in, float *out, size_t n, size_t stride)
+{
+	size_t t;
+
+	for(t = 0; t < n; t++) out[t*stride] = (float)do_sample(in[t*stride]);
+
+	return;
+}
+
+void 
+Filter::set_fft_threshold( int num_taps )
+{
+	m_fft_threshold = num_taps;
+	if( m_error_flag != 0 ) return;
+
+	free_fft();
+	if( m_fft_threshold > 0 && m_num_taps >= m_fft_threshold ) setup_fft();
+
+	return;
+}
+
+// Without ENABLE_FFTW this leaves m_fft_len at 0 and the filter in direct form
+void 
+Filter::setup_fft()
+{
+#ifdef ENABLE_FFTW
+	int i, len;
+
+	// At least 2x the taps, so more than half of every FFT is new output
+	// while the latency stays around one to three filter lengths
+	for(len = 1; len < 2 * m_num_taps; len <<= 1);
+
+	m_fft_in = (float*)fftwf_malloc( len * sizeof(float) );
+	m_fft_out = (float*)fftwf_malloc( len * sizeof(float) );
+	m_fft_spec = (fftwf_complex*)fftwf_malloc( (len/2 + 1) * sizeof(fftwf_complex) );
+	m_fft_taps = (fftwf_complex*)fftwf_malloc( (len/2 + 1) * sizeof(fftwf_complex) );
+	m_fft_fwd = m_fft_inv = NULL;
+	m_fft_len = len;
+	if( m_fft_in == NULL || m_fft_out == NULL || m_fft_spec == NULL || m_fft_taps == NULL ){
+		free_fft();
+		return;
+	}
+
+	m_fft_fwd = fftwf_plan_dft_r2c_1d( len, m_fft_in, m_fft_spec, FFTW_ESTIMATE );
+	m_fft_inv = fftwf_plan_dft_c2r_1d( len, m_fft_spec, m_fft_out, FFTW_ESTIMATE );
+	if( m_fft_fwd == NULL || m_fft_inv == NULL ){
+		free_fft();
+		return;
+	}
+
+	// Taps spectrum, computed once through the same forward plan
+	for(i = 0; i < len; i++) m_fft_in[i] = i < m_num_taps ? (float)m_taps[i] : 0;
+	fftwf_execute( m_fft_fwd );
+	for(i = 0; i <= len/2; i++){
+		// FFTW's inverse is unnormalized, fold the 1/len in here
+		m_fft_taps[i][0] = m_fft_spec[i][0] / len;
+		m_fft_taps[i][1] = m_fft_spec[i][1] / len;
+	}
+
+	m_fft_block = len - (m_num_taps - 1);
+	init();
+#endif
+
+	return;
+}
+
+void 
+Filter::free_fft()
+{
+#ifdef ENABLE_FFTW
+	if( m_fft_len ){
+		if( m_fft_fwd != NULL ) fftwf_destroy_plan( m_fft_fwd );
+		if( m_fft_inv != NULL ) fftwf_destroy_plan( m_fft_inv );
+		if( m_fft_in != NULL ) fftwf_free( m_fft_in );
+		if( m_fft_out != NULL ) fftwf_free( m_fft_out );
+		if( m_fft_spec != NULL ) fftwf_free( m_fft_spec );
+		if( m_fft_taps != NULL ) fftwf_free( m_fft_taps );
+	}
+#endif
+	m_fft_len = m_fft_block = m_fft_fill = 0;
+
+	return;
+}
+
+// Overlap-save: hands back the previous block's output for this slot, and
+// once a whole block of new inputs is in, convolves it in one go
+double 
+Filter::fft_sample(double data_sample)
+{
+#ifdef ENABLE_FFTW
+	int i, hist = m_num_taps - 1;
+	float re, im;
 	double result;
 
-	if( m_error_flag != 0 ) return(0);
+	m_fft_in[hist + m_fft_fill] = (float)data_sample;
+	result = m_fft_out[hist + m_fft_fill];
 
-	for(i = m_num_taps - 1; i >= 1; i--){
-		m_sr[i] = m_sr[i-1];
-	}	
-	m_sr[0] = data_sample;
+	if( ++m_fft_fill == m_fft_block ){
+		fftwf_execute( m_fft_fwd );
+		for(i = 0; i <= m_fft_len/2; i++){
+			re = m_fft_spec[i][0]*m_fft_taps[i][0] - m_fft_spec[i][1]*m_fft_taps[i][1];
+			im = m_fft_spec[i][0]*m_fft_taps[i][1] + m_fft_spec[i][1]*m_fft_taps[i][0];
+			m_fft_spec[i][0] = re;
+			m_fft_spec[i][1] = im;
+		}
+		fftwf_execute( m_fft_inv );
 
-	result = 0;
-	for(i = 0; i < m_num_taps; i++) result += m_sr[i] * m_taps[i];
+		// The first num_taps-1 outputs wrapped around, the newest inputs
+		// become the history for the next block
+		memmove( m_fft_in, m_fft_in + m_fft_block, hist * sizeof(float) );
+		m_fft_fill = 0;
+	}
 
 	return result;
+#else
+	return data_sample;
+#endif
 }
@@ -82,6 +82,11 @@
  *     get_taps(double *taps): returns the filter taps in the array "taps"
  *     write_taps_to_file(char *filename): writes the filter taps to a file
  *     write_freqres_to_file(char *filename): output frequency response to a file
+ *     process(in, out, n, stride): filters a block of n float samples read
+ *         from in[i*stride] into out[i*stride] (in == out is fine). Each
+ *         output is (float)do_sample(in[i*stride]) exactly, both share
+ *         the same multiply-accumulate.
+ *     set_fft_threshold(num_taps): see overlap-save below.
  * 
  * Finally, a get_error_flag() function is provided.  Recommended usage
  * is to check the get_error_flag() return value for a non-zero
@@ -113,12 +118,28 @@
  * frequency response of an ideal filter (LPF, HPF, BPF) are used as
  * the filter taps.  The resulting filters have some ripple in the passband 
  * due to the Gibbs phenomenon; the filters are linear phase.
+ *
+ * OVERLAP-SAVE:
+ * Sharp bands need hundreds of taps, at which point convolving by FFT is
+ * far cheaper than the direct dot product. It is opt-in, because it adds
+ * latency: after set_fft_threshold(FILTER_FFT_MIN_TAPS), say, a filter with
+ * at least that many taps gathers its inputs into blocks of get_latency()
+ * samples and convolves each block with one forward and one inverse single
+ * precision FFT. do_sample() and process() then return the output for the
+ * input get_latency() samples earlier (zeros until the first block is
+ * done), within ~1e-6 of the full scale of the direct form result.
+ * set_fft_threshold(0), the default, keeps the direct form with zero latency.
+ *
+ * The FFT path is only compiled with ENABLE_FFTW defined (the define ofxFft
+ * uses for its FFTW backend). None of the projects here define it, so as
+ * shipped set_fft_threshold() is a no-op and every filter is direct form.
  */
 
 #ifndef _FILTER_H
 #define _FILTER_H
 
 #define MAX_NUM_FILTER_TAPS 1000
+#define FILTER_FFT_MIN_TAPS 128 //where overlap-save starts paying off, for set_fft_threshold()
 
 #include <stdio.h>
 #include <math.h>
@@ -126,6 +147,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <inttypes.h>
+#ifdef ENABLE_FFTW
+#include <fftw3.h>
+#endif
 
 enum filterType {LPF, HPF, BPF};
 
@@ -138,7 +162,30 @@ class Filter{
 		double m_Fx;
 		double m_lambda;
 		double *m_taps;
+		// Delay line stored twice over, so the newest m_num_taps samples are
+		// always contiguous at m_sr + m_pos without ever shifting them
 		double *m_sr;
+		int m_pos;
+		int m_symmetric; // taps[k] == taps[num_taps-1-k], true for all three designs
+		void find_symmetry();
+		double dot_window();
+
+		// Overlap-save state, only allocated when the FFT path is in use
+		int m_fft_threshold;
+		int m_fft_len;   // FFT size, a power of two
+		int m_fft_block; // new samples per FFT, m_fft_len - (m_num_taps - 1)
+		int m_fft_fill;  // new samples gathered so far in this block
+#ifdef ENABLE_FFTW
+		float *m_fft_in;  // last num_taps-1 inputs, then the block being gathered
+		float *m_fft_out; // previous block's convolution, valid from num_taps-1
+		fftwf_complex *m_fft_spec;
+		fftwf_complex *m_fft_taps; // spectrum of the taps, scaled by 1/m_fft_len
+		fftwf_plan m_fft_fwd;
+		fftwf_plan m_fft_inv;
+#endif
+		void setup_fft();
+		void free_fft();
+		double fft_sample(double data_sample);
 		void designLPF();
 		void designHPF();
 
@@ -152,7 +199,10 @@ class Filter{
 		~Filter( );
 		void init();
 		double do_sample(double data_sample);
+		void process(const float *in, float *out, size_t n, size_t stride = 1);
 		int get_error_flag(){return m_error_flag;};
+		void set_fft_threshold( int num_taps );
+		int get_latency(){return m_fft_len ? m_fft_block : 0;};
 		void get_taps( double *taps );
 		int write_taps_to_file( char* filename );
 		int write_freqres_to_file( char* filename );
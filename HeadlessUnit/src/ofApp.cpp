@@ -43,15 +43,46 @@
 #define RECEIVER_PORT 6789
 
 #define FREQUENCY_SAMPLING 500
-#define ALPHA_START 6
-#define ALPHA_END 15
-#define BETA_START 15
-#define BETA_END 28
+#define DECIMATION_FACTOR 4
+#define ANALYSIS_RATE (FREQUENCY_SAMPLING/DECIMATION_FACTOR)
+#define NUM_ANALYSIS_CHANNELS 2
 #define BUFFER_WEB_LENGTH 10000
 
+#define BAND_POWER_WINDOW ANALYSIS_RATE  //1 second
+#define BAND_POWER_HOP (ANALYSIS_RATE/10) //100ms
+#define BAND_POWER_HIGHPASS 0.5f //Hz, takes out electrode offset and drift ahead of the windows
+#define BAND_POWER_SETTLE ((int)(5*ANALYSIS_RATE/(2*M_PI*BAND_POWER_HIGHPASS))) //samples, 5 time constants of the high-pass
+#define ARTIFACT_HOLD (BAND_POWER_WINDOW + BAND_POWER_SETTLE) //samples an artifact taints: its window plus the high-pass ringing out
+#define FFTW_WISDOM_FILE "fftw.wisdom"
+
+#define FILTER_ORDER 4
+#define NUM_BAND_POWER_CHANNELS NUM_ANALYSIS_CHANNELS
+#define BAND_ALPHA 0
+#define BAND_BETA 1
+
+#define NUM_PLAYERS 2
+
 #define MAX_OUTPUT_TO_GAME 100
+#define NORMALIZER_HALF_LIFE (120*ANALYSIS_RATE/BAND_POWER_HOP) //frames, 2 minutes
+#define COUNT2_PER_MICROVOLT2 (1.f/(COUNT_TO_MICROVOLT*COUNT_TO_MICROVOLT)) //band powers are in ADC counts^2
+#define NORMALIZER_MIN_POWER (1e-3f*COUNT2_PER_MICROVOLT2) //1e-3 uV^2, band powers outside share the end bins
+#define NORMALIZER_MAX_POWER (1e5f*COUNT2_PER_MICROVOLT2)  //1e5 uV^2
+#define PAIR_AVERAGES (10*ANALYSIS_RATE/BAND_POWER_HOP) //segments, 10 seconds
 #define DEBUG_MODE 0
 
+//What the game hears as alpha and beta, indexed by BAND_ALPHA/BAND_BETA.
+//Wider than the textbook bands, which EEG_BANDS has for the filter bank.
+static const ofxFrequencyBand GAME_BANDS[] = {
+    {6, 15, "alpha"},
+    {15, 28, "beta"}
+};
+
+//Channels compared for coherence and asymmetry in every GAME_BANDS band,
+//indexes into the analysis channels
+static const ofxChannelPair CHANNEL_PAIRS[] = {
+    {0, 1, "ch1-ch2"}
+};
+
 //------------------------------------------------------------------------------
 void ofApp::setup()
 {
@@ -61,11 +92,32 @@ void ofApp::setup()
     
     cout << "In ofApp::setup()\n";
     
-    ofxbci.startStreaming();
-    ofxbci2.startStreaming();
+    //Scan the serial ports once and open a board per player
+    int numBoards = hub.setup(NUM_PLAYERS);
+    printf("Found %i OpenBCI boards\n", numBoards);
+
+    hub.startStreaming();
+
+    //Lets the hub spread timestamps over packets that arrive in the same read
+    hub.setSampleRate(FREQUENCY_SAMPLING);
+
+    //Fill dropped samples so every FFT window really is FREQUENCY_SAMPLING samples long
+    hub.setGapPolicy(GAP_INTERPOLATE);
+
+    //Parse all boards on the hub's I/O thread so packets don't wait on the 60fps frame
+    hub.start();
         
-    filtAlpha_player1.setup(4, FREQUENCY_SAMPLING, ALPHA_START, ALPHA_END);
-    filtBeta_player2.setup(4, FREQUENCY_SAMPLING, BETA_START, BETA_END);
+    //Windows are counted in raw packets, the detector runs ahead of the decimator.
+    //Packets hold raw ADC counts, so full scale is the largest count.
+    artifacts_player1.setup(NUM_ANALYSIS_CHANNELS, ARTIFACT_HOLD*DECIMATION_FACTOR, ADS1299_MAX_COUNT);
+    artifacts_player2.setup(NUM_ANALYSIS_CHANNELS, ARTIFACT_HOLD*DECIMATION_FACTOR, ADS1299_MAX_COUNT);
+    
+    decimator_player1.setup(NUM_ANALYSIS_CHANNELS, DECIMATION_FACTOR);
+    decimator_player2.setup(NUM_ANALYSIS_CHANNELS, DECIMATION_FACTOR);
+    
+    //Every EEG band of every analysis channel goes to the log
+    bandFilter_player1.setup(NUM_ANALYSIS_CHANNELS, FILTER_ORDER, ANALYSIS_RATE, ofxFrequencyBands(EEG_BANDS));
+    bandFilter_player2.setup(NUM_ANALYSIS_CHANNELS, FILTER_ORDER, ANALYSIS_RATE, ofxFrequencyBands(EEG_BANDS));
         
     
 
@@ -83,15 +135,29 @@ void ofApp::setup()
     uploadingToWeb = false;
     
     
-    //Make the buffer hold one second of data
-    int bufferSize = FREQUENCY_SAMPLING;
-    fft_chan1 = ofxFft::create(bufferSize, OF_FFT_WINDOW_HAMMING, OF_FFT_FFTW);
-    
-    fftoutput_board1_chan1.resize(fft_chan1->getBinSize());
-    fftoutput_board2_chan1.resize(fft_chan1->getBinSize());
+    //FFTW plans are measured once and kept in data/, later runs start straight away
+    ofxBatchFft::setWisdomFile(ofToDataPath(FFTW_WISDOM_FILE, true).c_str());
+    bandEngine_player1.setup(NUM_BAND_POWER_CHANNELS, ANALYSIS_RATE, BAND_POWER_WINDOW, BAND_POWER_HOP, SPECTRAL_WINDOW_HAMMING, ofxFrequencyBands(GAME_BANDS));
+    bandEngine_player2.setup(NUM_BAND_POWER_CHANNELS, ANALYSIS_RATE, BAND_POWER_WINDOW, BAND_POWER_HOP, SPECTRAL_WINDOW_HAMMING, ofxFrequencyBands(GAME_BANDS));
+    //Whatever slope is left in a window would leak into the low bins, fit it out
+    bandEngine_player1.setDetrend(DETREND_LINEAR, BAND_POWER_HIGHPASS);
+    bandEngine_player2.setDetrend(DETREND_LINEAR, BAND_POWER_HIGHPASS);
+#if BAND_POWER_ENGINE == BAND_POWER_WELCH
+    //Cross-spectra ride along on the same FFTs
+    vector<ofxChannelPair> pairs(CHANNEL_PAIRS, CHANNEL_PAIRS + sizeof(CHANNEL_PAIRS)/sizeof(CHANNEL_PAIRS[0]));
+    bandEngine_player1.setPairs(pairs, PAIR_AVERAGES);
+    bandEngine_player2.setPairs(pairs, PAIR_AVERAGES);
+#endif
+    
+    normalizer_player1.resize(bandEngine_player1.getNumBands());
+    normalizer_player2.resize(bandEngine_player2.getNumBands());
+    for (size_t b=0; b<normalizer_player1.size(); ++b) {
+        normalizer_player1[b].setup(NORMALIZER_HALF_LIFE, NORMALIZER_MIN_POWER, NORMALIZER_MAX_POWER);
+        normalizer_player2[b].setup(NORMALIZER_HALF_LIFE, NORMALIZER_MIN_POWER, NORMALIZER_MAX_POWER);
+    }
     
-    setupNewUser(0);
     setupNewUser(1);
+    setupNewUser(2);
     
     printf("finished setup()\n");
 }
@@ -101,7 +167,7 @@ void ofApp::setup()
 void ofApp::setupNewUser(int playerNumber){
     
     
-    if (playerNumber==0){
+    if (playerNumber==1){
         sessionStartTime_player1 = time(NULL);
         ostringstream filename;
         
@@ -109,24 +175,26 @@ void ofApp::setupNewUser(int playerNumber){
         cout << "Filename: " << filename.str().c_str();
         logFile_player1.open(filename.str().c_str());
         
-        //Init the user maxes at 1. to avoid any divide by 0 issues
-        user1_max_Alpha = 1.;
-        user1_max_Beta = 1.;
-        user1_last_Alpha =1.;
-        user1_last_Beta =1.;
+        //A new player, a new idea of what's high
+        for (size_t b=0; b<normalizer_player1.size(); ++b)
+            normalizer_player1[b].reset();
+        
+        //A new head on the electrodes, relearn what a normal jump looks like
+        artifacts_player1.reset();
     }
     else{
         sessionStartTime_player2 = time(NULL);
         ostringstream filename;
         
-        filename << "/Users/dangoodwin/Desktop/l" << sessionStartTime_player1 << "_player2.csv";
+        filename << "/Users/dangoodwin/Desktop/l" << sessionStartTime_player2 << "_player2.csv";
         cout << "Filename: " << filename.str().c_str();
-        logFile_player1.open(filename.str().c_str());
+        logFile_player2.open(filename.str().c_str());
         
-        user2_max_Alpha = 1.;
-        user2_max_Beta = 1.;
-        user2_last_Alpha =0.;
-        user2_last_Beta =0.;
+        //Player 2's history is theirs alone; player 1's carries on
+        for (size_t b=0; b<normalizer_player2.size(); ++b)
+            normalizer_player2[b].reset();
+        
+        artifacts_player2.reset();
     }
 }
 
@@ -141,9 +209,12 @@ void ofApp::reportDebugOSCEvent(string row){
 }
 
 
-//Transmit normalized values of the alpha and beta per player
-//based on the data we've seen so far for that player
-void ofApp::reportOSCEvent(int playerNum, float alpha, float beta){
+//Transmit normalized values of the alpha and beta per player: each is
+//its percentile among that player's recent clean windows, scaled to
+//MAX_OUTPUT_TO_GAME. timestampNs is the time of the last sample in the
+//window, as a third argument, and artifacts the window's ofxArtifactFlags
+//as a fourth, 0 when the window is clean.
+void ofApp::reportOSCEvent(int playerNum, float alpha, float beta, uint64_t timestampNs, unsigned char artifacts){
     
     
     ofxOscMessage m;
@@ -153,70 +224,43 @@ void ofApp::reportOSCEvent(int playerNum, float alpha, float beta){
     else
         m.setAddress("/player2eeg");
     
-    
-    if (playerNum==1){
-        
-        if (alpha > user1_max_Alpha && alpha <100.){
-            user1_max_Alpha = alpha;
-        }
-        else {
-            //We need to return the last value that it transmitted!
-            alpha = user1_last_Alpha;
-        }
-        
-        if (beta > user1_max_Beta && beta <100.){
-            user1_max_Beta = beta;
-        }
-        else {
-            //We need to return the last value that it transmitted!
-            beta = user1_last_Beta;
-        }
-        
-        //Return scaled output
-        m.addFloatArg((alpha/user1_max_Alpha)*MAX_OUTPUT_TO_GAME);
-        m.addFloatArg((beta/user1_max_Beta)*MAX_OUTPUT_TO_GAME);
-    }
-    else{
-        
-        if (alpha > user2_max_Alpha && alpha <100.){
-            user2_max_Alpha = alpha;
-        }
-        else {
-            //We need to return the last value that it transmitted!
-            alpha = user2_last_Alpha;
-        }
-        
-        if (beta > user2_max_Beta && beta <100.){
-            user2_max_Beta = beta;
-        }
-        else {
-            //We need to return the last value that it transmitted!
-            beta = user2_last_Beta;
-        }
+    vector<ofxQuantileNormalizer>& normalizers = (playerNum==1) ? normalizer_player1 : normalizer_player2;
+    const float values[2] = {alpha, beta};
+    const int bands[2] = {BAND_ALPHA, BAND_BETA};
+    for (int i=0; i<2; ++i) {
+        ofxQuantileNormalizer& normalizer = normalizers[bands[i]];
+        m.addFloatArg(normalizer.getPercentile(values[i])*MAX_OUTPUT_TO_GAME);
         
-        //Return scaled output
-        m.addFloatArg((alpha/user2_max_Alpha)*MAX_OUTPUT_TO_GAME);
-        m.addFloatArg((beta/user2_max_Beta)*MAX_OUTPUT_TO_GAME);
+        //A contaminated window is still sent, flagged, but stays out of the
+        //history so it can't shift what counts as high
+        if (!artifacts)
+            normalizer.add(values[i]);
     }
+    m.addInt64Arg(timestampNs);
+    m.addIntArg(artifacts);
     
     sender.sendMessage(m);
 }
 
-//Demean data inline
-vector<float> demeanData(vector<float> data){
-    vector<float> output;
+//Transmit the channel pair features of one frame: for each CHANNEL_PAIRS
+//pair and each GAME_BANDS band, the coherence (0-1) and the asymmetry
+//ln(power b / power a), then the timestamp and artifact flags as in
+//reportOSCEvent.
+void ofApp::reportPairOSCEvent(int playerNum, const float* features, int count, uint64_t timestampNs, unsigned char artifacts){
     
-    float avg = 0.;
-    for (int i=0; i<data.size(); ++i) {
-        avg+=data[i];
-    }
-    avg = avg/data.size();
+    ofxOscMessage m;
     
-    for (int i=0; i<data.size(); ++i) {
-        output.push_back(data[i] - avg);
-    }
+    if (playerNum==1)
+        m.setAddress("/player1pairs");
+    else
+        m.setAddress("/player2pairs");
+    
+    for (int i=0; i<count; ++i)
+        m.addFloatArg(features[i]);
+    m.addInt64Arg(timestampNs);
+    m.addIntArg(artifacts);
     
-    return output;
+    sender.sendMessage(m);
 }
 
 //------------------------------------------------------------------------------
@@ -226,23 +270,21 @@ void ofApp::update()
     /*-----------Making sure that all automatic setup has been complete-----------*/
     //Note that we reference it off the sessionStartTime for player 1, but it's equiv if we key off player2
     if (!hasSentAutoStart && time(NULL)>sessionStartTime_player1+5) {
-        ofxbci.startStreaming();
-        ofxbci2.startStreaming();
+        hub.startStreaming();
         hasSentAutoStart = true;
     }
     else if (!hasSentApplyFilter && time(NULL)>sessionStartTime_player1+7) {
-        ofxbci.toggleFilter(true);
-        ofxbci2.toggleFilter(true);
+        hub.toggleFilter(true);
         hasSentApplyFilter = true;
     }
     else if (!hasSentStopOtherChannels && time(NULL)>sessionStartTime_player1+9 ){
         
         printf("Disabling all other channels but 0 and 1\n");
         
-        for (int i = 2; i<8; ++i) {
-            ofxbci.changeChannelState(i, false);
+        for (int i = 2; i<8 && hub.getNumBoards()>0; ++i) {
+            hub.getBoard(0).changeChannelState(i, false);
         }
-        //ofxbci.triggerTestSignal(true);
+        //hub.getBoard(0).triggerTestSignal(true);
         hasSentStopOtherChannels = true;
         printf("Done");
         
@@ -251,20 +293,17 @@ void ofApp::update()
     
     
     /*-------------------- Process Data from the Wire --------------------*/
-    //Get any and all bytes off the serial port
-    ofxbci.update(false); //Param is to echo to the command line
-    ofxbci2.update(false);
-    
-    vector<dataPacket_ADS1299> newData = ofxbci.getData();
-
-    processNewUserData(1, newData);
-    //-----Trying the 2nd openbci board again
-    
-    
-    newData.clear();
-    
-    newData = ofxbci2.getData();
-    processNewUserData(2, newData);
+    //The hub thread has already parsed everything off the serial ports,
+    //board ids start at 0 and player numbers at 1. Packets are read in place
+    //out of each board's ring, at most two runs per board when it wraps.
+    for (int board = 0; board < hub.getNumBoards() && board < NUM_PLAYERS; ++board) {
+        const dataPacket_ADS1299* packets;
+        size_t count;
+        while ((count = hub.peekData(board, packets)) > 0) {
+            processNewUserData(board+1, packets, count);
+            hub.releaseData(board, count);
+        }
+    }
     
     /*-------------------- Process Data from the Wire --------------------*/
     
@@ -297,120 +336,94 @@ void ofApp::update()
 }
 
 
-void ofApp::processNewUserData(int playerNum, vector<dataPacket_ADS1299> newData){
+void ofApp::processNewUserData(int playerNum, const dataPacket_ADS1299* newData, size_t count){
     
     
-    double filtered_alpha1=0;
-    double filtered_beta1=0;
     
-    if (playerNum==1){
-        for (int i=0; i<newData.size(); ++i) {
-            // Note that we're only taking one value off the wire here (there should be at least 2 channels
-            filtered_alpha1 = filtAlpha_player1.update(newData[i].values[0]);
-            filtered_beta1 = filtBeta_player1.update(newData[i].values[0]);
-            
-            timeslice_board1_chan1.push_back(newData[i].values[0]);
-            
-            logFile_player1 << newData[i].values[0] << ",";
-            logFile_player1 << newData[i].values[1] << ",";
-            logFile_player1 << filtered_alpha1 << ",";
-            logFile_player1 << filtered_beta1 << ",";
-            
-            // Every 1 second of data, calc the FFT and do appropriate steps
-            if (timeslice_board1_chan1.size()>1 && timeslice_board1_chan1.size()%FREQUENCY_SAMPLING==0)
-            {
-                //Supposedly this function should work inline but we need to check
-                timeslice_board1_chan1 = demeanData(timeslice_board1_chan1);
-                
-                fft_chan1->setSignal(timeslice_board1_chan1);
-                
-                
-                float* curFft1 = fft_chan1->getAmplitude();
-                
-                ostringstream row;
-                
-                //For now, we will just sum the magnitudes together
-                float alpha = 0.;
-                float beta=0.;
-                
-                for (int i= 0; i<fft_chan1->getBinSize(); i++) {
-                    fftoutput_board1_chan1[i] = curFft1[i];
-                    
-                    if (i>ALPHA_START && i<ALPHA_END)
-                        alpha+=fftoutput_board1_chan1[i];
-                    else if (i>BETA_START && i<BETA_END)
-                        beta+=fftoutput_board1_chan1[i];
-                    
-                    row << fftoutput_board1_chan1[i] << ",";
-                }
-                printf("Sees %f, %f \n", alpha, beta);
-                
-                //Do some HEURISTICs to normalize the alpha/beta to good values for the game
-                //Empirically, we see good data being created no larger than 100.0, anything above is noise
-                
-                //Player numbers are 1 and 2
-                reportOSCEvent(1, alpha, beta);
-                
-                timeslice_board1_chan1.clear();
-                
-            }
-        }
+    if (count == 0)
+        return;
+    
+    //Check the raw samples before anything smooths artifacts away
+    ofxArtifactDetector& detector = (playerNum==1) ? artifacts_player1 : artifacts_player2;
+    if (artifactFlags.size() < count)
+        artifactFlags.resize(count);
+    detector.process(&newData[0].values[0], sizeof(dataPacket_ADS1299)/sizeof(float), count, NULL, &artifactFlags[0]);
+    
+    //Decimate the batch straight out of the packets, then run what is left
+    //through the player's filter bank in one go
+    ofxPolyphaseDecimator& decimator = (playerNum==1) ? decimator_player1 : decimator_player2;
+    const size_t maxDecimated = decimator.getMaxOutputs(count);
+    if (decimated.size() < maxDecimated*NUM_ANALYSIS_CHANNELS) {
+        decimated.resize(maxDecimated*NUM_ANALYSIS_CHANNELS);
+        decimatedIndex.resize(maxDecimated);
     }
-    //Now copy the code for player 2
-    else{
-        for (int i=0; i<newData.size(); ++i) {
-            // Note that we're only taking one value off the wire here (there should be at least 2 channels
-            filtered_alpha1 = filtAlpha_player2.update(newData[i].values[0]);
-            filtered_beta1 = filtBeta_player2.update(newData[i].values[0]);
-            
-            timeslice_board2_chan1.push_back(newData[i].values[0]);
-            
-            logFile_player2 << newData[i].values[0] << ",";
-            logFile_player2 << newData[i].values[1] << ",";
-            logFile_player2 << filtered_alpha1 << ",";
-            logFile_player2 << filtered_beta1 << ",";
-            
-            // Every 1 second of data, calc the FFT and do appropriate steps
-            if (timeslice_board2_chan1.size()>1 && timeslice_board2_chan1.size()%FREQUENCY_SAMPLING==0)
-            {
-                //Supposedly this function should work inline but we need to check
-                timeslice_board2_chan1 = demeanData(timeslice_board2_chan1);
-                
-                fft_chan1->setSignal(timeslice_board2_chan1);
-                
-                
-                float* curFft1 = fft_chan1->getAmplitude();
-                
-                ostringstream row;
-                
-                //For now, we will just sum the magnitudes together
-                float alpha = 0.;
-                float beta=0.;
-                
-                for (int i= 0; i<fft_chan1->getBinSize(); i++) {
-                    fftoutput_board2_chan1[i] = curFft1[i];
-                    
-                    if (i>ALPHA_START && i<ALPHA_END)
-                        alpha+=fftoutput_board2_chan1[i];
-                    else if (i>BETA_START && i<BETA_END)
-                        beta+=fftoutput_board2_chan1[i];
-                    
-                    row << fftoutput_board2_chan1[i] << ",";
-                }
-                printf("Sees %f, %f \n", alpha, beta);
-                
-                //Do some HEURISTICs to normalize the alpha/beta to good values for the game
-                //Empirically, we see good data being created no larger than 100.0, anything above is noise
-                
-                //Player numbers are 1 and 2
-                reportOSCEvent(2, alpha, beta);
-                
-                timeslice_board2_chan1.clear();
-                
-            }
-        }
-        
+    const size_t numDecimated = decimator.process(&newData[0].values[0], sizeof(dataPacket_ADS1299)/sizeof(float), count,
+                                                  &decimated[0], NUM_ANALYSIS_CHANNELS, &decimatedIndex[0]);
+    
+    ofxButterworthBank& bank = (playerNum==1) ? bandFilter_player1 : bandFilter_player2;
+    const size_t lanes = bank.getNumLanes();
+    if (filtered.size() < numDecimated*lanes) {
+        filtered.resize(numDecimated*lanes);
+        envelopes.resize(numDecimated*lanes);
+    }
+    if (numDecimated > 0)
+        bank.process(&decimated[0], NUM_ANALYSIS_CHANNELS, numDecimated, &filtered[0], lanes, &envelopes[0], lanes);
+    
+    //Band powers over a sliding window, one frame every BAND_POWER_HOP samples
+    ofxBandPowerEngine& engine = (playerNum==1) ? bandEngine_player1 : bandEngine_player2;
+    const size_t maxFrames = engine.getMaxFrames(numDecimated);
+    if (bandPower.size() < maxFrames*engine.getFrameStride()) {
+        bandPower.resize(maxFrames*engine.getFrameStride());
+        frameIndex.resize(maxFrames);
+    }
+    size_t numFrames = 0;
+#if BAND_POWER_ENGINE == BAND_POWER_WELCH
+    //Flagged segments stay out of Welch's average, or they would linger in
+    //the frames after the flags clear
+    if (decimatedFlags.size() < numDecimated)
+        decimatedFlags.resize(numDecimated);
+    for (size_t i=0; i<numDecimated; ++i)
+        decimatedFlags[i] = artifactFlags[decimatedIndex[i]];
+    const size_t pairStride = engine.getPairFrameStride();
+    if (pairFeatures.size() < maxFrames*pairStride)
+        pairFeatures.resize(maxFrames*pairStride);
+    if (numDecimated > 0)
+        numFrames = engine.process(&decimated[0], NUM_ANALYSIS_CHANNELS, numDecimated, &bandPower[0], &frameIndex[0],
+                                   pairStride > 0 ? &pairFeatures[0] : NULL, &decimatedFlags[0]);
+#else
+    if (numDecimated > 0)
+        numFrames = engine.process(&decimated[0], NUM_ANALYSIS_CHANNELS, numDecimated, &bandPower[0], &frameIndex[0]);
+#endif
+    
+    //Row: timestamp, the window's artifact flags, the analysis channels, then
+    //every lane's filtered signal and every lane's envelope power, in lane
+    //order (EEG_BANDS lowest first, channels within a band)
+    ofstream& logFile = (playerNum==1) ? logFile_player1 : logFile_player2;
+    for (size_t i=0; i<numDecimated; ++i) {
+        logFile << newData[decimatedIndex[i]].timestampNs;
+        logFile << "," << (int)artifactFlags[decimatedIndex[i]];
+        for (int c=0; c<NUM_ANALYSIS_CHANNELS; ++c)
+            logFile << "," << decimated[i*NUM_ANALYSIS_CHANNELS + c];
+        for (size_t l=0; l<lanes; ++l)
+            logFile << "," << filtered[i*lanes + l];
+        for (size_t l=0; l<lanes; ++l)
+            logFile << "," << envelopes[i*lanes + l];
+        logFile << "\n";
+    }
+    
+    for (size_t f=0; f<numFrames; ++f) {
+        //Channel 0's bands come first in each frame
+        float alpha = bandPower[f*engine.getFrameStride() + BAND_ALPHA];
+        float beta = bandPower[f*engine.getFrameStride() + BAND_BETA];
+        const size_t packet = decimatedIndex[frameIndex[f]];
+        printf("Sees %f, %f, artifacts %i \n", alpha, beta, (int)artifactFlags[packet]);
         
+        //Player numbers are 1 and 2
+        reportOSCEvent(playerNum, alpha, beta, newData[packet].timestampNs, artifactFlags[packet]);
+#if BAND_POWER_ENGINE == BAND_POWER_WELCH
+        if (pairStride > 0)
+            reportPairOSCEvent(playerNum, &pairFeatures[f*pairStride], pairStride, newData[packet].timestampNs, artifactFlags[packet]);
+#endif
     }
     
     
@@ -431,8 +444,7 @@ void ofApp::keyPressed(int key)
     
     if (key=='b'){
         cout << "YES CAUGHT PRESS";
-        ofxbci.startStreaming();
-        ofxbci2.startStreaming();
+        hub.startStreaming();
     }
     
     else if (key == 's')
@@ -442,19 +454,19 @@ void ofApp::keyPressed(int key)
     
     else if (key =='f')
     {
-        ofxbci.toggleFilter(true);
+        hub.toggleFilter(true);
     }
-    else if (key == ' ')
+    else if (key == ' ' && hub.getNumBoards()>0)
     {
         printf("Disabling all other channels but 0 and 1\n");
         
         for (int i = 2; i<8; ++i) {
-            ofxbci.changeChannelState(i, false);
+            hub.getBoard(0).changeChannelState(i, false);
         }
     }
-    else if (key == 't')
+    else if (key == 't' && hub.getNumBoards()>0)
     {
-        ofxbci.triggerTestSignal(true); //haven't implemented the way to turn it off yet ;)
+        hub.getBoard(0).triggerTestSignal(true); //haven't implemented the way to turn it off yet ;)
     }
     
     
@@ -28,10 +28,38 @@
 
 #include "ofMain.h"
 #include "ofxOpenBCI.h"
+#include "ofxOpenBCIHub.h"
 #include "ofxHttpUtils.h"
 #include "ofxOsc.h"
-#include "ofxFft.h"
-#include "ofxInlineFilter.h"
+#include "ofxButterworthBank.h"
+#include "ofxPolyphaseDecimator.h"
+#include "ofxSlidingSTFT.h"
+#include "ofxBandTracker.h"
+#include "ofxWelchPSD.h"
+#include "ofxArtifactDetector.h"
+#include "ofxQuantileNormalizer.h"
+
+//Which engine turns samples into band powers for the game. The STFT runs
+//one FFT per hop, the sliding DFT updates just the bins inside the bands
+//every sample. Both take the same arguments and give the same powers with
+//the window demeaned, but the sliding DFT can't fit out the line that
+//DETREND_LINEAR asks for, so a drifting signal leaks a little more into
+//its low bins.
+//Welch averages the last few overlapping segments, which is much steadier
+//than either single window, and is the one that also gives channel pair
+//coherence and asymmetry.
+#define BAND_POWER_STFT 0
+#define BAND_POWER_SLIDING_DFT 1
+#define BAND_POWER_WELCH 2
+#define BAND_POWER_ENGINE BAND_POWER_WELCH
+
+#if BAND_POWER_ENGINE == BAND_POWER_WELCH
+typedef ofxWelchPSD ofxBandPowerEngine;
+#elif BAND_POWER_ENGINE == BAND_POWER_SLIDING_DFT
+typedef ofxBandTracker ofxBandPowerEngine;
+#else
+typedef ofxSlidingSTFT ofxBandPowerEngine;
+#endif
 
 
 
@@ -48,16 +76,32 @@ public:
     void setupNewUser(int playerNumber);
     void concludeUserExperience(int playerNum, int score);
     
-    void processNewUserData(int playerNum, vector<dataPacket_ADS1299> input);
+    void processNewUserData(int playerNum, const dataPacket_ADS1299* newData, size_t count);
     //------------------OpenBCI----------------//
-    ofxOpenBCI ofxbci;
-    ofxOpenBCI ofxbci2;
+    //One board per player, all read from the hub's single I/O thread
+    ofxOpenBCIHub hub;
     
-    //------------Filters for alpha beta ------//
-    ofxInlineFilter filtAlpha_player1;
-    ofxInlineFilter filtBeta_player1;
-    ofxInlineFilter filtAlpha_player2;
-    ofxInlineFilter filtBeta_player2;
+    //----------Decimation ahead of analysis ---//
+    //Band analysis only needs content below ~40Hz, so everything downstream
+    //runs at ANALYSIS_RATE rather than the board's rate
+    ofxPolyphaseDecimator decimator_player1;
+    ofxPolyphaseDecimator decimator_player2;
+    vector<float> decimated;      //per-batch decimator output, reused between calls
+    vector<size_t> decimatedIndex; //packet each decimated sample was completed by
+
+    //----------Artifacts in the raw samples ---//
+    //Flags rail hits, flatlines and jumps per packet, and per band power
+    //window so the game can tell a real change from a movement
+    ofxArtifactDetector artifacts_player1;
+    ofxArtifactDetector artifacts_player2;
+    vector<unsigned char> artifactFlags; //per packet, flags of the window ending there
+
+    //------------EEG band filters ------//
+    //One bank per player filters every band of every channel in a single pass
+    ofxButterworthBank bandFilter_player1;
+    ofxButterworthBank bandFilter_player2;
+    vector<float> filtered;  //per-batch bank output, reused between calls
+    vector<float> envelopes; //per-batch envelope power of each lane
     
     
     //-------------Auto start bools -----------//
@@ -88,15 +132,10 @@ public:
     time_t sessionStartTime_player1;
     time_t sessionStartTime_player2;
     
-    float user1_max_Alpha;
-    float user1_max_Beta;
-    float user2_max_Alpha;
-    float user2_max_Beta;
-    
-    float user1_last_Alpha;
-    float user1_last_Beta;
-    float user2_last_Alpha;
-    float user2_last_Beta;
+    //One per game band, each band power goes to the game as its
+    //percentile among the player's recent clean windows
+    vector<ofxQuantileNormalizer> normalizer_player1;
+    vector<ofxQuantileNormalizer> normalizer_player2;
     
     int uploadTimePeriod;
     time_t lastUploadTime;
@@ -106,16 +145,18 @@ public:
     //-------- For posting to the OSC -------//
     ofxOscSender sender;
     ofxOscReceiver receiver;
-    void reportOSCEvent(int playerNum, float alpha, float beta);
+    void reportOSCEvent(int playerNum, float alpha, float beta, uint64_t timestampNs, unsigned char artifacts);
+    void reportPairOSCEvent(int playerNum, const float* features, int count, uint64_t timestampNs, unsigned char artifacts);
     void reportDebugOSCEvent(string row);
     bool uploadingToWeb;
     
-    ofxFft* fft_chan1;
-
-    //---------The battery of vectors to store time domain data-----//
-    vector<float> timeslice_board1_chan1;
-    vector<float> timeslice_board2_chan1;
-
-    vector<float> fftoutput_board1_chan1;
-    vector<float> fftoutput_board2_chan1;
+    //---------Band powers for the game -----//
+    //Overlapping windows, so the game hears about a change every hop rather
+    //than once a second
+    ofxBandPowerEngine bandEngine_player1;
+    ofxBandPowerEngine bandEngine_player2;
+    vector<float> bandPower;   //per-batch frames, reused between calls
+    vector<size_t> frameIndex; //decimated sample that completed each frame
+    vector<float> pairFeatures; //per-batch channel pair coherence/asymmetry, Welch only
+    vector<unsigned char> decimatedFlags; //artifact window flags per decimated sample, Welch only
 };
@@ -0,0 +1,105 @@
+//
+//  ofxAnalysisRing.cpp
+//  barbicanExhibit
+//
+
+#include "ofxAnalysisRing.h"
+#include <math.h>
+#include <algorithm>
+
+ofxAnalysisRing::ofxAnalysisRing(): numChannels(0), windowLen(0), detrend(DETREND_MEAN), pos(0), filled(0),
+    highpassCoef(0)
+{
+}
+
+bool ofxAnalysisRing::setup(int channels, int newWindowLen, ofxDetrendMode newDetrend, float highpassHz, float sampleRate)
+{
+    if (channels <= 0 || newWindowLen < 2 || highpassHz < 0 || (highpassHz > 0 && sampleRate <= 0))
+        return false;
+
+    numChannels = channels;
+    windowLen = newWindowLen;
+    detrend = newDetrend;
+    highpassCoef = highpassHz > 0 ? exp(-2 * M_PI * highpassHz / sampleRate) : 0;
+
+    ring.assign((size_t)numChannels * 2 * windowLen, 0.f);
+    sum.assign(numChannels, 0.);
+    weightedSum.assign(numChannels, 0.);
+    lastIn.assign(numChannels, 0.);
+    lastOut.assign(numChannels, 0.);
+    reset();
+    return true;
+}
+
+void ofxAnalysisRing::reset()
+{
+    std::fill(ring.begin(), ring.end(), 0.f);
+    std::fill(sum.begin(), sum.end(), 0.);
+    std::fill(weightedSum.begin(), weightedSum.end(), 0.);
+    std::fill(lastIn.begin(), lastIn.end(), 0.);
+    std::fill(lastOut.begin(), lastOut.end(), 0.);
+    pos = 0;
+    filled = 0;
+}
+
+void ofxAnalysisRing::push(const float* x)
+{
+    for (int c = 0; c < numChannels; c++) {
+        double in = x[c];
+        if (highpassCoef > 0) {
+            //Start from the first sample, not from a step up from zero
+            if (filled == 0)
+                lastIn[c] = in;
+            lastOut[c] = highpassCoef * (lastOut[c] + in - lastIn[c]);
+            lastIn[c] = in;
+            in = lastOut[c];
+        }
+
+        float* r = &ring[(size_t)c * 2 * windowLen];
+        const float value = (float)in;
+        const double oldest = r[pos];
+
+        //Every other sample moves one index closer to the start
+        weightedSum[c] += (windowLen - 1) * (double)value - (sum[c] - oldest);
+        sum[c] += value - oldest;
+        r[pos] = r[pos + windowLen] = value;
+    }
+
+    pos = (pos + 1 == windowLen) ? 0 : pos + 1;
+    if (filled < windowLen)
+        filled++;
+    if (pos == 0)
+        resync();
+}
+
+void ofxAnalysisRing::resync()
+{
+    for (int c = 0; c < numChannels; c++) {
+        const float* r = &ring[(size_t)c * 2 * windowLen + pos];
+        double s = 0, ws = 0;
+        for (int k = 0; k < windowLen; k++) {
+            s += r[k];
+            ws += (double)k * r[k];
+        }
+        sum[c] = s;
+        weightedSum[c] = ws;
+    }
+}
+
+void ofxAnalysisRing::getTrend(float* offsets, float* slopes) const
+{
+    const double n = windowLen;
+    const double k1 = n * (n - 1) / 2;           //sum of k
+    const double k2 = (n - 1) * n * (2 * n - 1) / 6; //sum of k^2
+    for (int c = 0; c < numChannels; c++) {
+        double offset = 0, slope = 0;
+        if (detrend == DETREND_MEAN) {
+            offset = sum[c] / n;
+        } else if (detrend == DETREND_LINEAR) {
+            slope = (n * weightedSum[c] - k1 * sum[c]) / (n * k2 - k1 * k1);
+            offset = (sum[c] - slope * k1) / n;
+        }
+        offsets[c] = (float)offset;
+        slopes[c] = (float)slope;
+    }
+}
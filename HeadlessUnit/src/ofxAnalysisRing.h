@@ -0,0 +1,77 @@
+//
+//  ofxAnalysisRing.h
+//  barbicanExhibit
+//
+//  The last windowLen samples of each channel, stored twice over so the
+//  window is always one contiguous run, plus what it takes to detrend that
+//  window without another pass over it. Each push updates the window's
+//  running sum and index-weighted sum in O(1), which is all a least squares
+//  line needs, and can run the input through a one-pole high-pass on the
+//  way in. The sums are recomputed exactly once per lap of the ring so
+//  rounding can't build up over a long session.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+enum ofxDetrendMode {
+    DETREND_NONE,   //raw window
+    DETREND_MEAN,   //subtract the window's mean
+    DETREND_LINEAR  //subtract the window's least squares line
+};
+
+class ofxAnalysisRing {
+public:
+    ofxAnalysisRing();
+
+    //highpassHz = 0 stores the input as it is
+    bool setup(int numChannels, int windowLen, ofxDetrendMode detrend = DETREND_MEAN,
+               float highpassHz = 0, float sampleRate = 0);
+
+    //Empties the window and the high-pass state
+    void reset();
+
+    //Adds one sample of every channel, channel c at x[c]
+    void push(const float* x);
+
+    bool isFull() const { return filled == windowLen; }
+    int getNumChannels() const { return numChannels; }
+    int getWindowLength() const { return windowLen; }
+    ofxDetrendMode getDetrend() const { return detrend; }
+
+    //Channel c's window, oldest first, is getWindow()[c*getDistance() + k]
+    //for k < getWindowLength()
+    const float* getWindow() const { return &ring[pos]; }
+    size_t getDistance() const { return 2 * (size_t)windowLen; }
+
+    //The sample about to leave channel c's window on the next push, and the
+    //one the last push added (after the high-pass)
+    float getOldest(int channel) const { return ring[(size_t)channel * 2 * windowLen + pos]; }
+    float getNewest(int channel) const { return ring[(size_t)channel * 2 * windowLen + pos + windowLen - 1]; }
+
+    //Trend of each channel's window under the detrend mode: sample k of
+    //channel c, oldest k = 0, detrends to x[k] - offsets[c] - slopes[c]*k.
+    //These are the offsets/slopes ofxBatchFft takes.
+    void getTrend(float* offsets, float* slopes) const;
+
+private:
+    void resync();
+
+    int numChannels;
+    int windowLen;
+    ofxDetrendMode detrend;
+    std::vector<float> ring; //[channel][2*windowLen]
+    int pos;                 //slot the next sample goes in, the oldest one
+    int filled;
+
+    //Per channel sum of x[k] and of k*x[k] over the window
+    std::vector<double> sum;
+    std::vector<double> weightedSum;
+
+    //One-pole high-pass y[n] = a*(y[n-1] + x[n] - x[n-1]), off if a == 0
+    double highpassCoef;
+    std::vector<double> lastIn;
+    std::vector<double> lastOut;
+};
@@ -0,0 +1,186 @@
+//
+//  ofxArtifactDetector.cpp
+//  barbicanExhibit
+//
+
+#include "ofxArtifactDetector.h"
+#include <math.h>
+#include <algorithm>
+
+const float MAD_TO_SIGMA = 1.4826f; //MAD of a normal distribution is 0.6745 sigma
+
+ofxP2Quantile::ofxP2Quantile(double newP): p(newP)
+{
+    reset();
+}
+
+void ofxP2Quantile::reset()
+{
+    for (int i = 0; i < 5; i++) {
+        q[i] = 0;
+        n[i] = i;
+    }
+    np[0] = 0;
+    np[1] = 2 * p;
+    np[2] = 4 * p;
+    np[3] = 2 + 2 * p;
+    np[4] = 4;
+    dn[0] = 0;
+    dn[1] = p / 2;
+    dn[2] = p;
+    dn[3] = (1 + p) / 2;
+    dn[4] = 1;
+    count = 0;
+}
+
+void ofxP2Quantile::add(double x)
+{
+    //The first five just fill the markers
+    if (count < 5) {
+        q[count++] = x;
+        if (count == 5)
+            std::sort(q, q + 5);
+        return;
+    }
+    count++;
+
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (x >= q[k + 1])
+            k++;
+    }
+    for (int i = k + 1; i < 5; i++)
+        n[i]++;
+    for (int i = 0; i < 5; i++)
+        np[i] += dn[i];
+
+    for (int i = 1; i < 4; i++) {
+        double d = np[i] - n[i];
+        if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+            int s = d > 0 ? 1 : -1;
+            double parabolic = q[i] + s / (n[i + 1] - n[i - 1]) *
+                ((n[i] - n[i - 1] + s) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                 (n[i + 1] - n[i] - s) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+            if (q[i - 1] < parabolic && parabolic < q[i + 1])
+                q[i] = parabolic;
+            else
+                q[i] += s * (q[i + s] - q[i]) / (n[i + s] - n[i]);
+            n[i] += s;
+        }
+    }
+}
+
+double ofxP2Quantile::get() const
+{
+    if (count >= 5)
+        return q[2];
+    if (count == 0)
+        return 0;
+
+    //Too few for markers, the exact quantile of what there is
+    double sorted[5];
+    std::copy(q, q + count, sorted);
+    std::sort(sorted, sorted + count);
+    return sorted[(size_t)(p * (count - 1) + 0.5)];
+}
+
+ofxArtifactDetector::ofxArtifactDetector(): numChannels(0), windowLen(0), railLevel(0),
+    outlierSigmas(ARTIFACT_OUTLIER_SIGMAS), flatlineSamples(ARTIFACT_FLATLINE_SAMPLES), now(0)
+{
+}
+
+bool ofxArtifactDetector::setup(int newNumChannels, int newWindowLen, float fullScale, float newOutlierSigmas,
+                                int newFlatlineSamples, float railFraction)
+{
+    if (newNumChannels <= 0 || newWindowLen < 1 || fullScale <= 0 || newFlatlineSamples < 2)
+        return false;
+
+    numChannels = newNumChannels;
+    windowLen = newWindowLen;
+    railLevel = fullScale * railFraction;
+    outlierSigmas = newOutlierSigmas;
+    flatlineSamples = newFlatlineSamples;
+    channels = std::vector<Channel>(numChannels);
+    reset();
+    return true;
+}
+
+void ofxArtifactDetector::reset()
+{
+    for (int c = 0; c < numChannels; c++) {
+        channels[c].median.reset();
+        channels[c].mad.reset();
+        channels[c].last = 0;
+        channels[c].sameRun = 0;
+    }
+    now = 0;
+    //0 is never, samples count from 1
+    for (int f = 0; f < 3; f++)
+        lastFlagged[f] = 0;
+}
+
+unsigned char ofxArtifactDetector::getWindowFlags() const
+{
+    unsigned char flags = ARTIFACT_NONE;
+    for (int f = 0; f < 3; f++) {
+        if (lastFlagged[f] > 0 && now - lastFlagged[f] < (size_t)windowLen)
+            flags |= 1 << f;
+    }
+    return flags;
+}
+
+void ofxArtifactDetector::process(const float* in, size_t inStride, size_t n, unsigned char* sampleFlags,
+                                  unsigned char* windowFlags)
+{
+    if (numChannels == 0)
+        return;
+
+    for (size_t t = 0; t < n; t++) {
+        const float* x = in + t * inStride;
+        unsigned char flags = ARTIFACT_NONE;
+        now++;
+
+        for (int c = 0; c < numChannels; c++) {
+            Channel& ch = channels[c];
+
+            if (fabsf(x[c]) >= railLevel)
+                flags |= ARTIFACT_AMPLITUDE;
+
+            //The first sample has no predecessor to compare with
+            if (now > 1) {
+                ch.sameRun = (x[c] == ch.last) ? ch.sameRun + 1 : 0;
+                if (ch.sameRun + 1 >= flatlineSamples)
+                    flags |= ARTIFACT_FLATLINE;
+
+                //Judge against the spread so far, then learn from the sample.
+                //Flagged jumps still count: the median and MAD shrug off a
+                //few, and leaving them out could lock onto a too small spread.
+                const double d = (double)x[c] - ch.last;
+                const double median = ch.median.get();
+                const double deviation = fabs(d - median);
+                const double sigma = MAD_TO_SIGMA * ch.mad.get();
+                if (ch.median.getCount() >= (size_t)windowLen && sigma > 0 && deviation > outlierSigmas * sigma)
+                    flags |= ARTIFACT_OUTLIER;
+                ch.median.add(d);
+                ch.mad.add(deviation);
+            }
+            ch.last = x[c];
+        }
+
+        for (int f = 0; f < 3; f++) {
+            if (flags & (1 << f))
+                lastFlagged[f] = now;
+        }
+        if (sampleFlags)
+            sampleFlags[t] = flags;
+        if (windowFlags)
+            windowFlags[t] = getWindowFlags();
+    }
+}
@@ -0,0 +1,100 @@
+//
+//  ofxArtifactDetector.h
+//  barbicanExhibit
+//
+//  Streaming artifact flags for raw multichannel EEG, O(1) per sample:
+//  - amplitude: a sample near the ADC's rails, i.e. the amp saturated
+//  - flatline: the same value over and over, i.e. a lead off or a dead channel
+//  - outlier: a sample-to-sample jump far outside the channel's usual spread,
+//    judged against a running median and MAD (P-square estimates, so no history
+//    is kept). Differences ignore the electrode's DC offset and slow drift,
+//    and catch pops and movement.
+//  A window is contaminated if any of its samples is, so every sample also
+//  gets the flags of the window ending on it, for tagging analysis frames.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+enum ofxArtifactFlag {
+    ARTIFACT_NONE = 0,
+    ARTIFACT_AMPLITUDE = 1,
+    ARTIFACT_FLATLINE = 2,
+    ARTIFACT_OUTLIER = 4
+};
+
+#define ARTIFACT_RAIL_FRACTION 0.95f //of full scale
+#define ARTIFACT_OUTLIER_SIGMAS 8.f  //robust standard deviations (1.4826 MAD)
+#define ARTIFACT_FLATLINE_SAMPLES 25 //identical samples in a row, 50ms at 500Hz
+
+//P-square estimate of one quantile (Jain & Chlamtac 1985): five markers,
+//nudged towards their ideal positions with a parabolic fit on every update
+class ofxP2Quantile {
+public:
+    ofxP2Quantile(double p = 0.5);
+    void reset();
+    void add(double x);
+    double get() const;
+    size_t getCount() const { return count; }
+
+private:
+    double p;
+    double q[5];  //marker heights
+    double n[5];  //marker positions
+    double np[5]; //desired positions
+    double dn[5]; //desired position increments
+    size_t count;
+};
+
+class ofxArtifactDetector {
+public:
+    ofxArtifactDetector();
+
+    //windowLen is the analysis window in input samples, fullScale the
+    //largest magnitude the ADC can report in the input's units. The outlier
+    //check waits for a window's worth of samples to learn the spread first.
+    bool setup(int numChannels, int windowLen, float fullScale,
+               float outlierSigmas = ARTIFACT_OUTLIER_SIGMAS,
+               int flatlineSamples = ARTIFACT_FLATLINE_SAMPLES,
+               float railFraction = ARTIFACT_RAIL_FRACTION);
+
+    //Forgets the statistics, e.g. for a new player
+    void reset();
+
+    //Checks n samples, channel c of sample t at in[t*inStride + c]. For each
+    //sample, sampleFlags[t] is the OR of its channels' ofxArtifactFlags and
+    //windowFlags[t] the OR over the window ending on it. Either may be NULL.
+    void process(const float* in, size_t inStride, size_t n, unsigned char* sampleFlags,
+                 unsigned char* windowFlags);
+
+    //Flags of the window ending on the last sample processed
+    unsigned char getWindowFlags() const;
+
+    int getNumChannels() const { return numChannels; }
+
+    //Running robust statistics of a channel's sample-to-sample differences
+    float getMedian(int channel) const { return (float)channels[channel].median.get(); }
+    float getMAD(int channel) const { return (float)channels[channel].mad.get(); }
+
+private:
+    struct Channel {
+        ofxP2Quantile median;
+        ofxP2Quantile mad;
+        float last;
+        int sameRun;
+    };
+
+    int numChannels;
+    int windowLen;
+    float railLevel;
+    float outlierSigmas;
+    int flatlineSamples;
+    std::vector<Channel> channels;
+
+    //Sample count, and when each flag last fired, so a window's flags are
+    //just a comparison per flag
+    size_t now;
+    size_t lastFlagged[3];
+};
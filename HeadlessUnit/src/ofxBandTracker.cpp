@@ -0,0 +1,145 @@
+//
+//  ofxBandTracker.cpp
+//  barbicanExhibit
+//
+
+#include "ofxBandTracker.h"
+#include <math.h>
+#include <algorithm>
+
+ofxBandTracker::ofxBandTracker(): numChannels(0), sampleRate(0), windowLen(0), hop(0), a0(1), a1(0), powerScale(0),
+    lowBin(0), numBins(0), sinceFrame(0)
+{
+}
+
+bool ofxBandTracker::setup(int channels, float newSampleRate, int newWindowLen, int newHop, ofxSpectralWindow window,
+                           const std::vector<ofxFrequencyBand>& newBands)
+{
+    hop = 0;
+    if (channels <= 0 || newSampleRate <= 0 || newWindowLen < 4 || newHop < 1 || newBands.empty())
+        return false;
+
+    numChannels = channels;
+    sampleRate = newSampleRate;
+    windowLen = newWindowLen;
+    bands = newBands;
+
+    //Same [low, high) rule as ofxSlidingSTFT, inside 1 .. N/2-1
+    int highest = (windowLen - 1) / 2;
+    firstBin.resize(bands.size());
+    lastBin.resize(bands.size());
+    int minBin = highest, maxBin = 1;
+    for (size_t b = 0; b < bands.size(); b++) {
+        firstBin[b] = std::max(1, (int)ceil(bands[b].low * windowLen / sampleRate));
+        lastBin[b] = std::min(highest, (int)ceil(bands[b].high * windowLen / sampleRate) - 1);
+        if (firstBin[b] <= lastBin[b]) {
+            minBin = std::min(minBin, firstBin[b]);
+            maxBin = std::max(maxBin, lastBin[b]);
+        }
+    }
+    if (minBin > maxBin)
+        return false;
+
+    //The window needs each band bin's neighbours too
+    lowBin = minBin - 1;
+    numBins = maxBin + 1 - lowBin + 1;
+    twiddleRe.resize(numBins);
+    twiddleIm.resize(numBins);
+    for (int i = 0; i < numBins; i++) {
+        double w = 2 * M_PI * (lowBin + i) / windowLen;
+        twiddleRe[i] = cos(w);
+        twiddleIm[i] = sin(w);
+    }
+
+    ofxSpectralWindowCoefficients(window, a0, a1);
+    //Sum of w^2 over a periodic cosine window is N*(a0^2 + a1^2/2)
+    powerScale = 2.0 / ((double)windowLen * windowLen * (a0 * a0 + a1 * a1 / 2));
+
+    re.assign((size_t)numChannels * numBins, 0.);
+    im.assign((size_t)numChannels * numBins, 0.);
+    deltas.resize(numChannels);
+    if (!ring.setup(numChannels, windowLen, DETREND_NONE))
+        return false;
+    reset();
+    hop = newHop;
+    return true;
+}
+
+bool ofxBandTracker::setDetrend(ofxDetrendMode detrend, float highpassHz)
+{
+    bool ok = ring.setup(numChannels, windowLen, detrend, highpassHz, sampleRate);
+    reset();
+    return ok;
+}
+
+void ofxBandTracker::reset()
+{
+    std::fill(re.begin(), re.end(), 0.);
+    std::fill(im.begin(), im.end(), 0.);
+    ring.reset();
+    sinceFrame = 0;
+}
+
+size_t ofxBandTracker::process(const float* in, size_t inStride, size_t n, float* bandPower, size_t* frameIndex)
+{
+    if (hop == 0)
+        return 0;
+
+    const double* tr = &twiddleRe[0];
+    const double* ti = &twiddleIm[0];
+    size_t frames = 0;
+
+    for (size_t t = 0; t < n; t++) {
+        for (int c = 0; c < numChannels; c++)
+            deltas[c] = -ring.getOldest(c);
+        ring.push(in + t * inStride);
+
+        for (int c = 0; c < numChannels; c++) {
+            const double delta = deltas[c] + ring.getNewest(c);
+
+            //Independent bins, this loop vectorizes
+            double* xr = &re[(size_t)c * numBins];
+            double* xi = &im[(size_t)c * numBins];
+            for (int i = 0; i < numBins; i++) {
+                double r = xr[i] + delta;
+                double m = xi[i];
+                xr[i] = r * tr[i] - m * ti[i];
+                xi[i] = r * ti[i] + m * tr[i];
+            }
+        }
+        sinceFrame++;
+
+        if (ring.isFull() && sinceFrame >= hop) {
+            computeFrame(bandPower + frames * getFrameStride());
+            if (frameIndex)
+                frameIndex[frames] = t;
+            frames++;
+            sinceFrame = 0;
+        }
+    }
+    return frames;
+}
+
+void ofxBandTracker::computeFrame(float* bandPower)
+{
+    const int numBands = getNumBands();
+    const double half = a1 / 2;
+    for (int c = 0; c < numChannels; c++) {
+        const double* xr = &re[(size_t)c * numBins];
+        const double* xi = &im[(size_t)c * numBins];
+        for (int b = 0; b < numBands; b++) {
+            double power = 0;
+            for (int k = firstBin[b]; k <= lastBin[b]; k++) {
+                int i = k - lowBin;
+                //Bin 0 is the window's sum, leaving it out of bin 1's window
+                //is exactly demeaning the window like the other engines do
+                double lowR = (k == 1) ? 0 : xr[i - 1];
+                double lowI = (k == 1) ? 0 : xi[i - 1];
+                double wr = a0 * xr[i] - half * (lowR + xr[i + 1]);
+                double wi = a0 * xi[i] - half * (lowI + xi[i + 1]);
+                power += wr * wr + wi * wi;
+            }
+            bandPower[c * numBands + b] = (float)(power * powerScale);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+//
+//  ofxBandTracker.h
+//  barbicanExhibit
+//
+//  Band powers from a sliding DFT that only keeps the bins the bands need.
+//  Every sample rotates each tracked bin once, X[k] = (X[k] + x[n] - x[n-N]) * e^(j*2*pi*k/N),
+//  so an update is O(tracked bins) per channel instead of a whole FFT per
+//  window, and the estimate is never more than one sample old. Takes the
+//  same setup() and process() arguments as ofxSlidingSTFT, so the two can be
+//  swapped.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "ofxFrequencyBand.h"
+#include "ofxAnalysisRing.h"
+
+class ofxBandTracker {
+public:
+    ofxBandTracker();
+
+    //Bins of a windowLen point DFT at sampleRate, reported every hop samples
+    //(hop = 1 for every sample). The window is applied in the frequency
+    //domain from each bin's neighbours, with the DC bin taken as 0, so the
+    //window is always demeaned. DC and Nyquist are never reported.
+    bool setup(int numChannels, float sampleRate, int windowLen, int hop, ofxSpectralWindow window,
+               const std::vector<ofxFrequencyBand>& bands);
+
+    //Same arguments as ofxSlidingSTFT::setDetrend(), but only the high-pass
+    //does anything here: the window is always demeaned, and a sliding DFT
+    //can't refit a line per window, so DETREND_LINEAR acts like DETREND_MEAN.
+    //Empties the ring and the bins.
+    bool setDetrend(ofxDetrendMode detrend, float highpassHz = 0);
+
+    void reset();
+
+    //Same layout as ofxSlidingSTFT::process()
+    size_t process(const float* in, size_t inStride, size_t n, float* bandPower, size_t* frameIndex = NULL);
+
+    size_t getMaxFrames(size_t n) const { return hop > 0 ? n / hop + 1 : 0; }
+    int getFrameStride() const { return numChannels * getNumBands(); }
+    int getNumChannels() const { return numChannels; }
+    int getNumBands() const { return (int)bands.size(); }
+    int getWindowLength() const { return windowLen; }
+    int getHop() const { return hop; }
+    int getFirstBin(int band) const { return firstBin[band]; }
+    int getLastBin(int band) const { return lastBin[band]; }
+    int getNumTrackedBins() const { return numBins; }
+
+private:
+    void computeFrame(float* bandPower);
+
+    int numChannels;
+    float sampleRate;
+    int windowLen;
+    int hop;
+    std::vector<ofxFrequencyBand> bands;
+    std::vector<int> firstBin;
+    std::vector<int> lastBin;
+
+    float a0, a1; //window, see ofxSpectralWindowCoefficients()
+    double powerScale;
+
+    //Bins lowBin .. lowBin+numBins-1, one neighbour beyond every band edge
+    int lowBin;
+    int numBins;
+    std::vector<double> twiddleRe;
+    std::vector<double> twiddleIm;
+
+    //State is double so the running sums cancel x[n-N] exactly enough to
+    //run for hours without drifting. [channel][bin]
+    std::vector<double> re;
+    std::vector<double> im;
+
+    ofxAnalysisRing ring;       //last windowLen inputs, after the high-pass
+    std::vector<double> deltas; //[channel], x[n] - x[n-N] of the current sample
+    int sinceFrame;
+};
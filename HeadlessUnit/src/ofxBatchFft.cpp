@@ -0,0 +1,188 @@
+//
+//  ofxBatchFft.cpp
+//  barbicanExhibit
+//
+
+#include "ofxBatchFft.h"
+#include <math.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+    struct PlanKey {
+        int size;
+        int window;
+        int count;
+        bool operator<(const PlanKey& o) const
+        {
+            if (size != o.size) return size < o.size;
+            if (window != o.window) return window < o.window;
+            return count < o.count;
+        }
+    };
+
+    //One mutex for the cache and for every call into FFTW's planner
+    std::mutex& plannerMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::map<PlanKey, ofxBatchFft*>& planCache()
+    {
+        static std::map<PlanKey, ofxBatchFft*> cache;
+        return cache;
+    }
+
+    std::string& wisdomFile()
+    {
+        static std::string path;
+        return path;
+    }
+
+    //Per-thread buffers, grown as needed and allocated with fftwf_malloc so
+    //they have the alignment the plans were made for
+    struct Scratch {
+        float* in;
+        fftwf_complex* out;
+        size_t inSize;
+        size_t outSize;
+        Scratch(): in(NULL), out(NULL), inSize(0), outSize(0) {}
+        ~Scratch()
+        {
+            fftwf_free(in);
+            fftwf_free(out);
+        }
+        void reserve(size_t newIn, size_t newOut)
+        {
+            if (newIn > inSize) {
+                fftwf_free(in);
+                in = (float*)fftwf_malloc(newIn * sizeof(float));
+                inSize = newIn;
+            }
+            if (newOut > outSize) {
+                fftwf_free(out);
+                out = (fftwf_complex*)fftwf_malloc(newOut * sizeof(fftwf_complex));
+                outSize = newOut;
+            }
+        }
+    };
+
+    thread_local Scratch scratch;
+}
+
+ofxBatchFft* ofxBatchFft::get(int size, ofxSpectralWindow window, int count)
+{
+    if (size < 2 || count < 1)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock(plannerMutex());
+    PlanKey key = {size, (int)window, count};
+    std::map<PlanKey, ofxBatchFft*>::iterator it = planCache().find(key);
+    if (it != planCache().end())
+        return it->second;
+
+    ofxBatchFft* fft = new ofxBatchFft(size, window, count);
+    if (fft->plan == NULL) {
+        delete fft;
+        return NULL;
+    }
+    planCache()[key] = fft;
+
+    if (!wisdomFile().empty())
+        fftwf_export_wisdom_to_filename(wisdomFile().c_str());
+    return fft;
+}
+
+bool ofxBatchFft::setWisdomFile(const char* path)
+{
+    std::lock_guard<std::mutex> lock(plannerMutex());
+    wisdomFile() = path ? path : "";
+    if (wisdomFile().empty())
+        return false;
+    return fftwf_import_wisdom_from_filename(path) != 0;
+}
+
+//Only called by get(), with the planner mutex held
+ofxBatchFft::ofxBatchFft(int newSize, ofxSpectralWindow newWindow, int newCount):
+    size(newSize), count(newCount), windowType(newWindow), windowPower(0), plan(NULL)
+{
+    float a0, a1;
+    ofxSpectralWindowCoefficients(windowType, a0, a1);
+    window.resize(size);
+    for (int k = 0; k < size; k++) {
+        window[k] = a0 - a1 * cos(2 * M_PI * k / size);
+        windowPower += window[k] * window[k];
+    }
+
+    //FFTW_MEASURE scribbles over the arrays while planning, so plan on
+    //throwaway buffers. Executing on the scratch buffers later is fine as
+    //both come from fftwf_malloc and so are aligned alike.
+    const int bins = getNumBins();
+    float* in = (float*)fftwf_malloc((size_t)size * count * sizeof(float));
+    fftwf_complex* out = (fftwf_complex*)fftwf_malloc((size_t)bins * count * sizeof(fftwf_complex));
+    if (in && out) {
+        unsigned flags = wisdomFile().empty() ? FFTW_ESTIMATE : FFTW_MEASURE;
+        plan = fftwf_plan_many_dft_r2c(1, &size, count, in, NULL, 1, size, out, NULL, 1, bins, flags);
+    }
+    fftwf_free(in);
+    fftwf_free(out);
+}
+
+ofxBatchFft::~ofxBatchFft()
+{
+    if (plan)
+        fftwf_destroy_plan(plan);
+}
+
+fftwf_complex* ofxBatchFft::execute(const float* in, size_t inStride, size_t inDist, const float* offsets,
+                                    const float* slopes) const
+{
+    const int bins = getNumBins();
+    scratch.reserve((size_t)size * count, (size_t)bins * count);
+
+    for (int i = 0; i < count; i++) {
+        const float* src = in + i * inDist;
+        float* dst = scratch.in + (size_t)i * size;
+        const float offset = offsets ? offsets[i] : 0.f;
+        if (slopes) {
+            const float slope = slopes[i];
+            for (int k = 0; k < size; k++)
+                dst[k] = (src[k * inStride] - offset - slope * k) * window[k];
+        } else {
+            for (int k = 0; k < size; k++)
+                dst[k] = (src[k * inStride] - offset) * window[k];
+        }
+    }
+
+    //The new-array execute is the thread safe way to share a plan
+    fftwf_execute_dft_r2c(plan, scratch.in, scratch.out);
+    return scratch.out;
+}
+
+void ofxBatchFft::transform(const float* in, size_t inStride, size_t inDist, const float* offsets,
+                            fftwf_complex* spectra, size_t specDist, const float* slopes) const
+{
+    const int bins = getNumBins();
+    const fftwf_complex* out = execute(in, inStride, inDist, offsets, slopes);
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < bins; k++) {
+            spectra[i * specDist + k][0] = out[(size_t)i * bins + k][0];
+            spectra[i * specDist + k][1] = out[(size_t)i * bins + k][1];
+        }
+    }
+}
+
+void ofxBatchFft::power(const float* in, size_t inStride, size_t inDist, const float* offsets,
+                        float* power, size_t powerDist, const float* slopes) const
+{
+    const int bins = getNumBins();
+    const fftwf_complex* out = execute(in, inStride, inDist, offsets, slopes);
+    for (int i = 0; i < count; i++) {
+        const fftwf_complex* x = out + (size_t)i * bins;
+        float* p = power + i * powerDist;
+        for (int k = 0; k < bins; k++)
+            p[k] = x[k][0] * x[k][0] + x[k][1] * x[k][1];
+    }
+}
@@ -0,0 +1,70 @@
+//
+//  ofxBatchFft.h
+//  barbicanExhibit
+//
+//  Windowed real FFTs of several equally long signals in one FFTW "many"
+//  call. Plans are created once per (size, window, count) and shared by the
+//  whole process; with a wisdom file set, FFTW's measured plans are saved to
+//  disk and the next start-up reuses them instead of measuring again.
+//
+//  get() and setWisdomFile() lock around FFTW's planner, which isn't thread
+//  safe. transform()/power() only execute a finished plan on per-thread
+//  scratch buffers, so any number of threads can share one instance.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <fftw3.h>
+#include "ofxFrequencyBand.h"
+
+class ofxBatchFft {
+public:
+    //The shared instance for these parameters, planned on first use. Never
+    //deleted, the cache lives as long as the process. NULL if FFTW can't plan it.
+    static ofxBatchFft* get(int size, ofxSpectralWindow window, int count);
+
+    //Loads wisdom from path now and saves it there after every new plan.
+    //Plans made after this use FFTW_MEASURE, without a file FFTW_ESTIMATE.
+    static bool setWisdomFile(const char* path);
+
+    //Signal i is in[i*inDist + k*inStride] for k < getSize(). If offsets
+    //isn't NULL, offsets[i] is subtracted first (e.g. the signal's mean),
+    //and if slopes isn't NULL, slopes[i]*k as well (a linear trend, see
+    //ofxAnalysisRing::getTrend()).
+    //Bin k of signal i goes to spectra[i*specDist + k], k < getNumBins().
+    void transform(const float* in, size_t inStride, size_t inDist, const float* offsets,
+                   fftwf_complex* spectra, size_t specDist, const float* slopes = NULL) const;
+
+    //Same, but writes |X[k]|^2 to power[i*powerDist + k]
+    void power(const float* in, size_t inStride, size_t inDist, const float* offsets,
+               float* power, size_t powerDist, const float* slopes = NULL) const;
+
+    int getSize() const { return size; }
+    int getNumBins() const { return size / 2 + 1; }
+    int getCount() const { return count; }
+    ofxSpectralWindow getWindowType() const { return windowType; }
+    const float* getWindow() const { return &window[0]; }
+
+    //Sum of window^2, for turning |X|^2 into power
+    double getWindowPower() const { return windowPower; }
+
+private:
+    ofxBatchFft(int size, ofxSpectralWindow window, int count);
+    ~ofxBatchFft();
+    ofxBatchFft(const ofxBatchFft&);
+    ofxBatchFft& operator=(const ofxBatchFft&);
+
+    //Windows the inputs into this thread's scratch and runs the plan,
+    //returns the scratch spectra
+    fftwf_complex* execute(const float* in, size_t inStride, size_t inDist, const float* offsets,
+                           const float* slopes) const;
+
+    int size;
+    int count;
+    ofxSpectralWindow windowType;
+    std::vector<float> window;
+    double windowPower;
+    fftwf_plan plan;
+};
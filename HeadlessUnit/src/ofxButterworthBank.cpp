@@ -0,0 +1,235 @@
+//
+//  ofxButterworthBank.cpp
+//  barbicanExhibit
+//
+
+#include "ofxButterworthBank.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+//The lane vector the bank runs on, doubles because the poles of a narrow EEG
+//band sit close enough to the unit circle that float state drifts
+#if defined(__AVX2__)
+typedef __m256d BankVec;
+const int BANK_WIDTH = 4;
+static inline BankVec bankLoad(const double* p) { return _mm256_loadu_pd(p); }
+static inline BankVec bankSet(double v) { return _mm256_set1_pd(v); }
+static inline void bankStore(double* p, BankVec v) { _mm256_storeu_pd(p, v); }
+static inline BankVec bankLoadInput(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+static inline void bankStoreOutput(float* p, BankVec v) { _mm_storeu_ps(p, _mm256_cvtpd_ps(v)); }
+static inline BankVec bankAdd(BankVec a, BankVec b) { return _mm256_add_pd(a, b); }
+static inline BankVec bankSub(BankVec a, BankVec b) { return _mm256_sub_pd(a, b); }
+static inline BankVec bankMul(BankVec a, BankVec b) { return _mm256_mul_pd(a, b); }
+#if defined(__FMA__)
+static inline BankVec bankMulAdd(BankVec a, BankVec b, BankVec c) { return _mm256_fmadd_pd(a, b, c); }
+#else
+static inline BankVec bankMulAdd(BankVec a, BankVec b, BankVec c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+typedef float64x2_t BankVec;
+const int BANK_WIDTH = 2;
+static inline BankVec bankLoad(const double* p) { return vld1q_f64(p); }
+static inline BankVec bankSet(double v) { return vdupq_n_f64(v); }
+static inline void bankStore(double* p, BankVec v) { vst1q_f64(p, v); }
+static inline BankVec bankLoadInput(const float* p) { return vcvt_f64_f32(vld1_f32(p)); }
+static inline void bankStoreOutput(float* p, BankVec v) { vst1_f32(p, vcvt_f32_f64(v)); }
+static inline BankVec bankAdd(BankVec a, BankVec b) { return vaddq_f64(a, b); }
+static inline BankVec bankSub(BankVec a, BankVec b) { return vsubq_f64(a, b); }
+static inline BankVec bankMul(BankVec a, BankVec b) { return vmulq_f64(a, b); }
+static inline BankVec bankMulAdd(BankVec a, BankVec b, BankVec c) { return vfmaq_f64(c, a, b); }
+#else
+typedef double BankVec;
+const int BANK_WIDTH = 1;
+static inline BankVec bankLoad(const double* p) { return *p; }
+static inline BankVec bankSet(double v) { return v; }
+static inline void bankStore(double* p, BankVec v) { *p = v; }
+static inline BankVec bankLoadInput(const float* p) { return *p; }
+static inline void bankStoreOutput(float* p, BankVec v) { *p = (float)v; }
+static inline BankVec bankAdd(BankVec a, BankVec b) { return a + b; }
+static inline BankVec bankSub(BankVec a, BankVec b) { return a - b; }
+static inline BankVec bankMul(BankVec a, BankVec b) { return a * b; }
+static inline BankVec bankMulAdd(BankVec a, BankVec b, BankVec c) { return a * b + c; }
+#endif
+
+const int SECTION_COEFS = 5; //A, d1..d4
+const int SECTION_STATE = 4; //w1..w4
+
+//This filter code was taken from http://www.exstrom.com/journal/sigproc/bwbpf.c
+//under GNU public license, like ofxInlineFilter
+int ofxButterworthDesignBandpass(int order, double sampleRate, double low, double high,
+                                 ofxButterworthSection* sections)
+{
+    int n = order / 4;
+    if (n < 1 || n > MAX_BUTTERWORTH_SECTIONS)
+        return 0;
+    if (sampleRate <= 0 || low <= 0 || high <= low || high >= sampleRate / 2)
+        return 0;
+
+    double a = cos(M_PI * (high + low) / sampleRate) / cos(M_PI * (high - low) / sampleRate);
+    double a2 = a * a;
+    double b = tan(M_PI * (high - low) / sampleRate);
+    double b2 = b * b;
+
+    for (int i = 0; i < n; ++i) {
+        double r = sin(M_PI * (2.0 * i + 1.0) / (4.0 * n));
+        double s = b2 + 2.0 * b * r + 1.0;
+        sections[i].A = b2 / s;
+        sections[i].d1 = 4.0 * a * (1.0 + b * r) / s;
+        sections[i].d2 = 2.0 * (b2 - 2.0 * a2 - 1.0) / s;
+        sections[i].d3 = 4.0 * a * (1.0 - b * r) / s;
+        sections[i].d4 = -(b2 - 2.0 * b * r + 1.0) / s;
+    }
+    return n;
+}
+
+ofxButterworthBank::ofxButterworthBank(): numChannels(0), numSections(0), paddedChannels(0), numVectors(0),
+    envelopeCoef(1)
+{
+}
+
+bool ofxButterworthBank::setup(int channels, int order, double sampleRate, const std::vector<ofxFrequencyBand>& newBands,
+                               double envelopeTime)
+{
+    numSections = 0;
+    if (channels <= 0 || newBands.empty() || envelopeTime < 0)
+        return false;
+
+    numChannels = channels;
+    bands = newBands;
+    paddedChannels = (numChannels + BANK_WIDTH - 1) / BANK_WIDTH * BANK_WIDTH;
+    numVectors = paddedChannels / BANK_WIDTH * (int)bands.size();
+
+    size_t paddedLanes = (size_t)paddedChannels * bands.size();
+    int sections = order / 4;
+    coefs.assign((size_t)sections * SECTION_COEFS * paddedLanes, 0.);
+    state.assign((size_t)sections * SECTION_STATE * paddedLanes, 0.);
+    envelopeState.assign(paddedLanes, 0.);
+    envelopeCoef = envelopeTime > 0 ? 1.0 - exp(-1.0 / (envelopeTime * sampleRate)) : 1.0;
+
+    for (size_t band = 0; band < bands.size(); band++) {
+        ofxButterworthSection design[MAX_BUTTERWORTH_SECTIONS];
+        if (ofxButterworthDesignBandpass(order, sampleRate, bands[band].low, bands[band].high, design) != sections)
+            return false;
+
+        //Padding lanes get real coefficients too, they only ever see zeros
+        for (int s = 0; s < sections; s++) {
+            const double values[SECTION_COEFS] = {design[s].A, design[s].d1, design[s].d2, design[s].d3, design[s].d4};
+            for (int k = 0; k < SECTION_COEFS; k++) {
+                double* row = &coefs[((size_t)s * SECTION_COEFS + k) * paddedLanes + band * paddedChannels];
+                for (int c = 0; c < paddedChannels; c++)
+                    row[c] = values[k];
+            }
+        }
+    }
+
+    numSections = sections;
+    return true;
+}
+
+void ofxButterworthBank::reset()
+{
+    std::fill(state.begin(), state.end(), 0.);
+    std::fill(envelopeState.begin(), envelopeState.end(), 0.);
+}
+
+void ofxButterworthBank::process(const float* in, size_t inStride, size_t numSamples, float* out, size_t outStride,
+                                 float* envelope, size_t envelopeStride)
+{
+    if (!isSetup())
+        return;
+
+    const size_t paddedLanes = (size_t)paddedChannels * bands.size();
+    const int vectorsPerBand = paddedChannels / BANK_WIDTH;
+
+    //One vector of lanes at a time through the whole block, so its state
+    //and coefficients stay in registers instead of going back to memory
+    //every sample
+    for (int v = 0; v < numVectors; v++) {
+        const int band = v / vectorsPerBand;
+        const int firstChannel = (v % vectorsPerBand) * BANK_WIDTH;
+        const int width = std::min(BANK_WIDTH, numChannels - firstChannel);
+        const size_t lane = (size_t)v * BANK_WIDTH;
+        float* dst = out + getLane(firstChannel, band);
+        float* env = envelope ? envelope + getLane(firstChannel, band) : NULL;
+
+        BankVec A[MAX_BUTTERWORTH_SECTIONS], d1[MAX_BUTTERWORTH_SECTIONS], d2[MAX_BUTTERWORTH_SECTIONS];
+        BankVec d3[MAX_BUTTERWORTH_SECTIONS], d4[MAX_BUTTERWORTH_SECTIONS];
+        BankVec w1[MAX_BUTTERWORTH_SECTIONS], w2[MAX_BUTTERWORTH_SECTIONS];
+        BankVec w3[MAX_BUTTERWORTH_SECTIONS], w4[MAX_BUTTERWORTH_SECTIONS];
+        for (int s = 0; s < numSections; s++) {
+            const double* c = &coefs[(size_t)s * SECTION_COEFS * paddedLanes + lane];
+            A[s] = bankLoad(c);
+            d1[s] = bankLoad(c + paddedLanes);
+            d2[s] = bankLoad(c + 2 * paddedLanes);
+            d3[s] = bankLoad(c + 3 * paddedLanes);
+            d4[s] = bankLoad(c + 4 * paddedLanes);
+            const double* w = &state[(size_t)s * SECTION_STATE * paddedLanes + lane];
+            w1[s] = bankLoad(w);
+            w2[s] = bankLoad(w + paddedLanes);
+            w3[s] = bankLoad(w + 2 * paddedLanes);
+            w4[s] = bankLoad(w + 3 * paddedLanes);
+        }
+        const BankVec k = bankSet(envelopeCoef);
+        BankVec e = bankLoad(&envelopeState[lane]);
+
+        for (size_t t = 0; t < numSamples; t++) {
+            const float* src = in + t * inStride + firstChannel;
+            BankVec x;
+            if (width == BANK_WIDTH) {
+                x = bankLoadInput(src);
+            } else {
+                //Last, partly padded vector of a band: don't read past the channels
+                float padded[BANK_WIDTH] = {0};
+                memcpy(padded, src, width * sizeof(float));
+                x = bankLoadInput(padded);
+            }
+
+            for (int s = 0; s < numSections; s++) {
+                BankVec w0 = bankMulAdd(d1[s], w1[s], bankMulAdd(d2[s], w2[s],
+                             bankMulAdd(d3[s], w3[s], bankMulAdd(d4[s], w4[s], x))));
+                x = bankMul(A[s], bankAdd(bankSub(bankSub(w0, w2[s]), w2[s]), w4[s]));
+                w4[s] = w3[s];
+                w3[s] = w2[s];
+                w2[s] = w1[s];
+                w1[s] = w0;
+            }
+
+            if (width == BANK_WIDTH) {
+                bankStoreOutput(dst + t * outStride, x);
+            } else {
+                float padded[BANK_WIDTH];
+                bankStoreOutput(padded, x);
+                memcpy(dst + t * outStride, padded, width * sizeof(float));
+            }
+
+            if (env) {
+                //e += k*(x^2 - e)
+                e = bankMulAdd(k, bankSub(bankMul(x, x), e), e);
+                if (width == BANK_WIDTH) {
+                    bankStoreOutput(env + t * envelopeStride, e);
+                } else {
+                    float padded[BANK_WIDTH];
+                    bankStoreOutput(padded, e);
+                    memcpy(env + t * envelopeStride, padded, width * sizeof(float));
+                }
+            }
+        }
+        if (env)
+            bankStore(&envelopeState[lane], e);
+
+        for (int s = 0; s < numSections; s++) {
+            double* w = &state[(size_t)s * SECTION_STATE * paddedLanes + lane];
+            bankStore(w, w1[s]);
+            bankStore(w + paddedLanes, w2[s]);
+            bankStore(w + 2 * paddedLanes, w3[s]);
+            bankStore(w + 3 * paddedLanes, w4[s]);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+//
+//  ofxButterworthBank.h
+//  barbicanExhibit
+//
+//  Butterworth bandpass filters for several channels x several bands at once.
+//  The exstrom.com bwbpf design that ofxInlineFilter uses, but cascaded
+//  properly: each section filters the previous one's output, where
+//  ofxInlineFilter::update() feeds the raw input to every section, so the
+//  two only agree up to order 4. Every (channel, band) pair is one lane of a structure-of-arrays state, so a
+//  block of multichannel samples goes through all the filters in one call
+//  with the lanes in AVX2 (4 doubles) or NEON (2 doubles) registers. The
+//  same pass can also track each lane's envelope power, the filtered
+//  signal squared and smoothed by a one-pole lowpass.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "ofxFrequencyBand.h"
+
+const int MAX_BUTTERWORTH_SECTIONS = 4; //order 16, far sharper than EEG bands need
+const double BUTTERWORTH_ENVELOPE_TIME = 0.25; //seconds, time constant of the envelope power
+
+//One 4th order bandpass section, w0 = d1*w1 + d2*w2 + d3*w3 + d4*w4 + x
+//and y = A*(w0 - 2*w2 + w4)
+struct ofxButterworthSection {
+    double A;
+    double d1, d2, d3, d4;
+};
+
+//Designs a bandpass of the given order (number of poles, rounded down to a
+//multiple of 4) into sections. Returns the number of sections written.
+int ofxButterworthDesignBandpass(int order, double sampleRate, double low, double high,
+                                 ofxButterworthSection* sections);
+
+class ofxButterworthBank {
+public:
+    ofxButterworthBank();
+
+    //Every band gets the same order. Returns false if the order or a band
+    //does not make sense for sampleRate. envelopeTime is the envelope power's
+    //time constant in seconds.
+    bool setup(int numChannels, int order, double sampleRate, const std::vector<ofxFrequencyBand>& bands,
+               double envelopeTime = BUTTERWORTH_ENVELOPE_TIME);
+
+    //Zeroes the filter and envelope state, keeps the design
+    void reset();
+
+    //Filters numSamples multichannel samples. Channel c of sample t is read
+    //from in[t*inStride + c], so a batch of packets can be passed as
+    //&packets[0].values[0] with inStride = sizeof(packet)/sizeof(float).
+    //The output for (channel, band) is written to out[t*outStride + getLane(channel, band)];
+    //pass outStride = getNumLanes() for a packed block. If envelope isn't
+    //NULL, each lane's envelope power (mean square of its output, in the
+    //units of the spectral engines' band powers) goes to
+    //envelope[t*envelopeStride + lane] in the same pass.
+    void process(const float* in, size_t inStride, size_t numSamples, float* out, size_t outStride,
+                 float* envelope = NULL, size_t envelopeStride = 0);
+
+    int getNumChannels() const { return numChannels; }
+    int getNumBands() const { return (int)bands.size(); }
+    int getNumLanes() const { return numChannels * getNumBands(); }
+    int getLane(int channel, int band) const { return band * numChannels + channel; }
+    const ofxFrequencyBand& getBand(int band) const { return bands[band]; }
+    bool isSetup() const { return numSections > 0; }
+
+private:
+    int numChannels;
+    int numSections;
+    std::vector<ofxFrequencyBand> bands;
+
+    //Each band's row of channels is padded up to a whole number of vectors,
+    //so a vector never spans two bands and its input is contiguous
+    int paddedChannels;
+    int numVectors;
+
+    //[section][coefficient][padded lane] and [section][w1..w4][padded lane]
+    std::vector<double> coefs;
+    std::vector<double> state;
+
+    double envelopeCoef;              //one-pole smoothing per sample
+    std::vector<double> envelopeState; //[padded lane]
+};
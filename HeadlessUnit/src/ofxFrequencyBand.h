@@ -0,0 +1,52 @@
+//
+//  ofxFrequencyBand.h
+//  barbicanExhibit
+//
+//  A frequency range in Hz and the analysis windows, shared by the filter
+//  bank and the spectral band-power engines.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+struct ofxFrequencyBand {
+    float low;  //Hz
+    float high; //Hz
+    const char* name; //for logs, may be NULL
+};
+
+//The canonical EEG bands, lowest first
+const ofxFrequencyBand EEG_BANDS[] = {
+    {0.5f, 4.f,  "delta"},
+    {4.f,  8.f,  "theta"},
+    {8.f,  13.f, "alpha"},
+    {13.f, 30.f, "beta"},
+    {30.f, 45.f, "gamma"}
+};
+
+//A band table as the vector the bank and the engines take
+template <size_t N>
+inline std::vector<ofxFrequencyBand> ofxFrequencyBands(const ofxFrequencyBand (&table)[N])
+{
+    return std::vector<ofxFrequencyBand>(table, table + N);
+}
+
+//Windows are the periodic (DFT-even) form w[m] = a0 - a1*cos(2*pi*m/N), so
+//they can also be applied in the frequency domain as
+//a0*X[k] - a1/2*(X[k-1] + X[k+1])
+enum ofxSpectralWindow {
+    SPECTRAL_WINDOW_RECTANGULAR,
+    SPECTRAL_WINDOW_HANN,
+    SPECTRAL_WINDOW_HAMMING
+};
+
+inline void ofxSpectralWindowCoefficients(ofxSpectralWindow window, float& a0, float& a1)
+{
+    switch (window) {
+        case SPECTRAL_WINDOW_HANN:    a0 = 0.5f;  a1 = 0.5f;  break;
+        case SPECTRAL_WINDOW_HAMMING: a0 = 0.54f; a1 = 0.46f; break;
+        default:                      a0 = 1.f;   a1 = 0.f;   break;
+    }
+}
@@ -0,0 +1,103 @@
+//
+//  ofxPolyphaseDecimator.cpp
+//  barbicanExhibit
+//
+
+#include "ofxPolyphaseDecimator.h"
+#include <math.h>
+#include <algorithm>
+
+ofxPolyphaseDecimator::ofxPolyphaseDecimator(): numChannels(0), factor(0), tapsPerPhase(0), phase(0), pos(0)
+{
+}
+
+bool ofxPolyphaseDecimator::setup(int channels, int newFactor, int newTapsPerPhase)
+{
+    factor = 0;
+    if (channels <= 0 || newFactor < 1 || newTapsPerPhase < 1)
+        return false;
+
+    numChannels = channels;
+    factor = newFactor;
+    tapsPerPhase = (factor == 1) ? 1 : newTapsPerPhase;
+
+    //Hamming windowed sinc lowpass, normalized to unity gain at DC
+    int numTaps = factor * tapsPerPhase;
+    std::vector<double> h(numTaps);
+    double cutoff = DECIMATOR_CUTOFF * 0.5 / factor; //cycles per input sample
+    double sum = 0;
+    for (int k = 0; k < numTaps; k++) {
+        double m = k - (numTaps - 1) / 2.0;
+        double sinc = (m == 0) ? 2 * cutoff : sin(2 * M_PI * cutoff * m) / (M_PI * m);
+        double window = (numTaps > 1) ? 0.54 - 0.46 * cos(2 * M_PI * k / (numTaps - 1)) : 1;
+        h[k] = sinc * window;
+        sum += h[k];
+    }
+
+    //Output y = sum h[k]*x[newest - k]. With k = j*factor + r, the input r
+    //samples before the end of a period is branch q = factor-1-r.
+    branchTaps.resize(numTaps);
+    for (int q = 0; q < factor; q++)
+        for (int j = 0; j < tapsPerPhase; j++)
+            branchTaps[q * tapsPerPhase + j] = (float)(h[j * factor + factor - 1 - q] / sum);
+
+    delay.assign((size_t)factor * 2 * tapsPerPhase * numChannels, 0.f);
+    acc.resize(numChannels);
+    reset();
+    return true;
+}
+
+void ofxPolyphaseDecimator::reset()
+{
+    std::fill(delay.begin(), delay.end(), 0.f);
+    phase = 0;
+    pos = 0;
+}
+
+size_t ofxPolyphaseDecimator::process(const float* in, size_t inStride, size_t n, float* out, size_t outStride,
+                                      size_t* inputIndex)
+{
+    if (factor == 0)
+        return 0;
+
+    const size_t C = numChannels;
+    const size_t P = tapsPerPhase;
+    const size_t branchLen = 2 * P * C;
+    size_t outputs = 0;
+
+    for (size_t t = 0; t < n; t++) {
+        //Commutator: each input goes to the next branch, both copies
+        const float* x = in + t * inStride;
+        float* slot = &delay[phase * branchLen + pos * C];
+        for (size_t c = 0; c < C; c++)
+            slot[c] = slot[c + P * C] = x[c];
+
+        if (++phase < factor)
+            continue;
+
+        //A full period is in, sum every branch's FIR over its own window.
+        //Channels are innermost so these loops vectorize across channels.
+        std::fill(acc.begin(), acc.end(), 0.f);
+        for (int q = 0; q < factor; q++) {
+            const float* taps = &branchTaps[q * P];
+            const float* window = &delay[q * branchLen + pos * C];
+            for (size_t j = 0; j < P; j++) {
+                const float h = taps[j];
+                const float* w = window + j * C;
+                for (size_t c = 0; c < C; c++)
+                    acc[c] += h * w[c];
+            }
+        }
+
+        float* y = out + outputs * outStride;
+        for (size_t c = 0; c < C; c++)
+            y[c] = acc[c];
+        if (inputIndex)
+            inputIndex[outputs] = t;
+        outputs++;
+
+        phase = 0;
+        pos = (pos == 0) ? (int)P - 1 : pos - 1;
+    }
+    return outputs;
+}
@@ -0,0 +1,58 @@
+//
+//  ofxPolyphaseDecimator.h
+//  barbicanExhibit
+//
+//  Anti-alias lowpass + integer downsampling for interleaved multichannel
+//  data. The FIR is split into factor polyphase branches, so only the
+//  samples that are kept are ever computed: tapsPerPhase multiply-adds per
+//  channel per input sample, whatever the factor.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+const int DECIMATOR_TAPS_PER_PHASE = 16;
+const float DECIMATOR_CUTOFF = 0.8f; //passband edge as a fraction of the output Nyquist
+
+class ofxPolyphaseDecimator {
+public:
+    ofxPolyphaseDecimator();
+
+    //factor 1 passes samples straight through. Returns false for nonsense arguments.
+    bool setup(int numChannels, int factor, int tapsPerPhase = DECIMATOR_TAPS_PER_PHASE);
+
+    //Zeroes the delay lines and restarts the output phase
+    void reset();
+
+    //Reads n samples, channel c of sample t at in[t*inStride + c], and writes
+    //one output every factor inputs to out[k*outStride + c]. If inputIndex
+    //isn't NULL, inputIndex[k] is the t whose arrival completed output k,
+    //e.g. to look up its timestamp. Returns the number of outputs, at most
+    //getMaxOutputs(n).
+    size_t process(const float* in, size_t inStride, size_t n, float* out, size_t outStride,
+                   size_t* inputIndex = NULL);
+
+    size_t getMaxOutputs(size_t n) const { return factor > 0 ? (n + factor - 1) / factor : 0; }
+    int getFactor() const { return factor; }
+    int getNumChannels() const { return numChannels; }
+
+    //Group delay of the linear phase lowpass, in input samples
+    float getDelay() const { return (factor * tapsPerPhase - 1) / 2.f; }
+
+private:
+    int numChannels;
+    int factor;
+    int tapsPerPhase;
+    int phase; //inputs taken towards the next output
+    int pos;   //newest slot of every branch's delay line
+
+    //branchTaps[q*tapsPerPhase + j] multiplies the j-th newest sample of branch q
+    std::vector<float> branchTaps;
+
+    //Each branch's delay line is stored twice over so its window is always
+    //contiguous, channels innermost: [branch][2*tapsPerPhase][channel]
+    std::vector<float> delay;
+    std::vector<float> acc;
+};
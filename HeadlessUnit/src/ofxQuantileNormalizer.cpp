@@ -0,0 +1,121 @@
+//
+//  ofxQuantileNormalizer.cpp
+//  barbicanExhibit
+//
+
+#include "ofxQuantileNormalizer.h"
+#include <math.h>
+#include <algorithm>
+
+//Weights grow geometrically, rescale everything before they can overflow
+const double RESCALE_WEIGHT = 1e200;
+
+ofxQuantileNormalizer::ofxQuantileNormalizer(): numBins(0), logMin(0), binsPerLog(0), growth(1),
+    nextWeight(1), total(0)
+{
+}
+
+bool ofxQuantileNormalizer::setup(double halfLife, float minValue, float maxValue, int newNumBins)
+{
+    numBins = 0;
+    if (halfLife <= 0 || minValue <= 0 || maxValue <= minValue || newNumBins < 2)
+        return false;
+
+    numBins = newNumBins;
+    logMin = log(minValue);
+    binsPerLog = numBins / (log(maxValue) - logMin);
+    growth = pow(2.0, 1.0 / halfLife);
+    tree.resize(numBins + 1);
+    reset();
+    return true;
+}
+
+void ofxQuantileNormalizer::reset()
+{
+    std::fill(tree.begin(), tree.end(), 0.);
+    nextWeight = 1;
+    total = 0;
+}
+
+double ofxQuantileNormalizer::binOf(float value) const
+{
+    if (value <= 0)
+        return 0;
+    double position = (log(value) - logMin) * binsPerLog;
+    return std::min(std::max(position, 0.0), numBins - 1e-9);
+}
+
+void ofxQuantileNormalizer::addToTree(int bin, double weight)
+{
+    for (int i = bin + 1; i <= numBins; i += i & -i)
+        tree[i] += weight;
+}
+
+double ofxQuantileNormalizer::prefixSum(int bins) const
+{
+    double sum = 0;
+    for (int i = bins; i > 0; i -= i & -i)
+        sum += tree[i];
+    return sum;
+}
+
+void ofxQuantileNormalizer::add(float value)
+{
+    if (numBins == 0)
+        return;
+
+    addToTree((int)binOf(value), nextWeight);
+    total += nextWeight;
+    nextWeight *= growth;
+
+    //Scaling every weight by the same factor changes no percentile
+    if (nextWeight > RESCALE_WEIGHT) {
+        const double scale = 1 / nextWeight;
+        for (int i = 1; i <= numBins; i++)
+            tree[i] *= scale;
+        total *= scale;
+        nextWeight = 1;
+    }
+}
+
+float ofxQuantileNormalizer::getPercentile(float value) const
+{
+    if (numBins == 0 || total <= 0)
+        return 0.5f;
+
+    double position = binOf(value);
+    int bin = (int)position;
+    double below = prefixSum(bin);
+    double inBin = prefixSum(bin + 1) - below;
+    return (float)((below + inBin * (position - bin)) / total);
+}
+
+float ofxQuantileNormalizer::getQuantile(float p) const
+{
+    if (numBins == 0)
+        return 0;
+
+    //Walk down the Fenwick tree for the last bin whose prefix is below target
+    double target = std::min(std::max((double)p, 0.0), 1.0) * total;
+    int bin = 0;
+    double below = 0;
+    int step = 1;
+    while (step * 2 <= numBins)
+        step *= 2;
+    for (; step > 0; step /= 2) {
+        if (bin + step <= numBins && below + tree[bin + step] < target) {
+            bin += step;
+            below += tree[bin];
+        }
+    }
+    bin = std::min(bin, numBins - 1);
+    double inBin = prefixSum(bin + 1) - below;
+    double fraction = inBin > 0 ? (target - below) / inBin : 0;
+    return (float)exp(logMin + (bin + fraction) / binsPerLog);
+}
+
+double ofxQuantileNormalizer::getCount() const
+{
+    //In units of the newest value's weight, nextWeight/growth
+    return total * growth / nextWeight;
+}
@@ -0,0 +1,57 @@
+//
+//  ofxQuantileNormalizer.h
+//  barbicanExhibit
+//
+//  Maps a feature to its percentile among the recent values of the same
+//  feature, so one spike can't squash everything after it the way a running
+//  max does. The history is a fixed size sketch: a histogram over
+//  logarithmic bins (band powers span decades) whose old entries fade with
+//  a half-life. Fading is done by giving each new value more weight than the
+//  last rather than shrinking every bin, and the bins sit in a Fenwick tree,
+//  so add() and getPercentile() cost O(log bins), with a fixed bin count.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#define QUANTILE_NORMALIZER_BINS 256
+
+class ofxQuantileNormalizer {
+public:
+    ofxQuantileNormalizer();
+
+    //Values are binned logarithmically between minValue and maxValue (both
+    //> 0), anything outside lands in the end bins. halfLife is in add()
+    //calls: a value counts half as much after that many newer ones.
+    bool setup(double halfLife, float minValue, float maxValue, int numBins = QUANTILE_NORMALIZER_BINS);
+
+    //Forgets the history
+    void reset();
+
+    void add(float value);
+
+    //Fraction of the (decayed) history below value, interpolated within the
+    //bin. 0.5 while there's no history yet.
+    float getPercentile(float value) const;
+
+    //Inverse of getPercentile(), p in [0, 1]
+    float getQuantile(float p) const;
+
+    //Decayed number of values in the history
+    double getCount() const;
+
+private:
+    double binOf(float value) const; //fractional bin position
+    void addToTree(int bin, double weight);
+    double prefixSum(int bins) const; //total of bins [0, bins)
+
+    int numBins;
+    double logMin;
+    double binsPerLog;
+    double growth;     //weight ratio between consecutive values
+    double nextWeight; //weight of the next value
+    double total;
+    std::vector<double> tree; //Fenwick tree of bin weights, 1-based
+};
@@ -0,0 +1,102 @@
+//
+//  ofxSlidingSTFT.cpp
+//  barbicanExhibit
+//
+
+#include "ofxSlidingSTFT.h"
+#include <math.h>
+#include <algorithm>
+
+ofxSlidingSTFT::ofxSlidingSTFT(): numChannels(0), sampleRate(0), windowLen(0), hop(0),
+    sinceFrame(0), powerScale(0), fft(NULL)
+{
+}
+
+bool ofxSlidingSTFT::setup(int channels, float rate, int newWindowLen, int newHop, ofxSpectralWindow windowType,
+                           const std::vector<ofxFrequencyBand>& newBands)
+{
+    hop = 0;
+    if (channels <= 0 || rate <= 0 || newWindowLen < 2 || newHop < 1 || newBands.empty())
+        return false;
+
+    numChannels = channels;
+    sampleRate = rate;
+    windowLen = newWindowLen;
+    bands = newBands;
+
+    //Bins whose centre frequency k*rate/windowLen falls in [low, high)
+    int nyquistBin = windowLen / 2;
+    firstBin.resize(bands.size());
+    lastBin.resize(bands.size());
+    for (size_t b = 0; b < bands.size(); b++) {
+        firstBin[b] = std::max(0, (int)ceil(bands[b].low * windowLen / rate));
+        lastBin[b] = std::min(nyquistBin, (int)ceil(bands[b].high * windowLen / rate) - 1);
+    }
+
+    fft = ofxBatchFft::get(windowLen, windowType, numChannels);
+    if (!fft)
+        return false;
+    //Parseval: the mean square is the one-sided sum of 2|X|^2/(N*sum w^2)
+    powerScale = 2.0 / (windowLen * fft->getWindowPower());
+
+    offsets.resize(numChannels);
+    slopes.resize(numChannels);
+    spectra.resize((size_t)numChannels * fft->getNumBins());
+    if (!ring.setup(numChannels, windowLen, DETREND_MEAN))
+        return false;
+    reset();
+    hop = newHop;
+    return true;
+}
+
+bool ofxSlidingSTFT::setDetrend(ofxDetrendMode detrend, float highpassHz)
+{
+    sinceFrame = 0;
+    return ring.setup(numChannels, windowLen, detrend, highpassHz, sampleRate);
+}
+
+void ofxSlidingSTFT::reset()
+{
+    ring.reset();
+    sinceFrame = 0;
+}
+
+size_t ofxSlidingSTFT::process(const float* in, size_t inStride, size_t n, float* bandPower, size_t* frameIndex)
+{
+    if (hop == 0)
+        return 0;
+
+    size_t frames = 0;
+    for (size_t t = 0; t < n; t++) {
+        ring.push(in + t * inStride);
+        sinceFrame++;
+
+        if (ring.isFull() && sinceFrame >= hop) {
+            computeFrame(bandPower + frames * getFrameStride());
+            if (frameIndex)
+                frameIndex[frames] = t;
+            frames++;
+            sinceFrame = 0;
+        }
+    }
+    return frames;
+}
+
+void ofxSlidingSTFT::computeFrame(float* bandPower)
+{
+    const int numBands = getNumBands();
+    const int numBins = fft->getNumBins();
+    ring.getTrend(&offsets[0], &slopes[0]);
+    const float* trendSlopes = ring.getDetrend() == DETREND_LINEAR ? &slopes[0] : NULL;
+    fft->power(ring.getWindow(), 1, ring.getDistance(), &offsets[0], &spectra[0], numBins, trendSlopes);
+
+    for (int c = 0; c < numChannels; c++) {
+        const float* p = &spectra[(size_t)c * numBins];
+        for (int b = 0; b < numBands; b++) {
+            double power = 0;
+            for (int k = firstBin[b]; k <= lastBin[b]; k++)
+                power += p[k];
+            bandPower[c * numBands + b] = (float)(power * powerScale);
+        }
+    }
+}
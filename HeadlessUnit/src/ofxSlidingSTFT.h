@@ -0,0 +1,75 @@
+//
+//  ofxSlidingSTFT.h
+//  barbicanExhibit
+//
+//  Streaming short-time Fourier transform that turns multichannel samples
+//  into band powers every hop. The last windowLen samples sit in an
+//  ofxAnalysisRing, which keeps the window contiguous and its trend up to
+//  date as samples arrive, so a frame is one batched FFT of all channels
+//  straight out of the ring, detrended while it's windowed, with no copying
+//  of the history and no allocation. The plan is ofxBatchFft's shared one
+//  for this window size, window and channel count.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "ofxBatchFft.h"
+#include "ofxAnalysisRing.h"
+
+class ofxSlidingSTFT {
+public:
+    ofxSlidingSTFT();
+
+    //e.g. windowLen = 1s and hop = 100ms worth of samples. Returns false for
+    //nonsense arguments.
+    bool setup(int numChannels, float sampleRate, int windowLen, int hop, ofxSpectralWindow window,
+               const std::vector<ofxFrequencyBand>& bands);
+
+    //Windows are demeaned unless this says otherwise. highpassHz > 0 also
+    //runs the input through a one-pole high-pass. Empties the ring.
+    bool setDetrend(ofxDetrendMode detrend, float highpassHz = 0);
+
+    //Empties the ring, the first frame then waits for a full window again
+    void reset();
+
+    //Pushes n samples, channel c of sample t at in[t*inStride + c]. Every hop
+    //samples once a full window is in, a frame is emitted: band b of channel c
+    //goes to bandPower[f*getFrameStride() + c*getNumBands() + b], and if
+    //frameIndex isn't NULL, frameIndex[f] is the t that completed the frame.
+    //bandPower needs room for getMaxFrames(n) frames. Returns the number of frames.
+    size_t process(const float* in, size_t inStride, size_t n, float* bandPower, size_t* frameIndex = NULL);
+
+    size_t getMaxFrames(size_t n) const { return hop > 0 ? n / hop + 1 : 0; }
+    int getFrameStride() const { return numChannels * getNumBands(); }
+    int getNumChannels() const { return numChannels; }
+    int getNumBands() const { return (int)bands.size(); }
+    int getWindowLength() const { return windowLen; }
+    int getHop() const { return hop; }
+
+    //Bins [getFirstBin(b), getLastBin(b)] have centre frequencies inside [low, high) of band b
+    int getFirstBin(int band) const { return firstBin[band]; }
+    int getLastBin(int band) const { return lastBin[band]; }
+
+private:
+    void computeFrame(float* bandPower);
+
+    int numChannels;
+    float sampleRate;
+    int windowLen;
+    int hop;
+    std::vector<ofxFrequencyBand> bands;
+    std::vector<int> firstBin;
+    std::vector<int> lastBin;
+
+    ofxAnalysisRing ring;
+    int sinceFrame;      //samples since the last frame
+
+    //Band power is the mean square of the band's part of the signal
+    float powerScale;
+    ofxBatchFft* fft;
+    std::vector<float> offsets; //[channel], this frame's trend
+    std::vector<float> slopes;
+    std::vector<float> spectra; //[channel][bin], |X|^2 of this frame
+};
@@ -0,0 +1,229 @@
+//
+//  ofxWelchPSD.cpp
+//  barbicanExhibit
+//
+
+#include "ofxWelchPSD.h"
+#include <math.h>
+#include <algorithm>
+
+ofxWelchPSD::ofxWelchPSD(): numChannels(0), sampleRate(0), segmentLen(0), hop(0), numBins(0),
+    averages(WELCH_DEFAULT_AVERAGES), sinceFrame(0), segments(0), fft(NULL), pairAverages(WELCH_DEFAULT_AVERAGES)
+{
+}
+
+bool ofxWelchPSD::setup(int channels, float rate, int newSegmentLen, int newHop, ofxSpectralWindow windowType,
+                        const std::vector<ofxFrequencyBand>& newBands, float newAverages)
+{
+    hop = 0;
+    if (channels <= 0 || rate <= 0 || newSegmentLen < 2 || newHop < 1 || newBands.empty() || newAverages < 1)
+        return false;
+
+    fft = ofxBatchFft::get(newSegmentLen, windowType, channels);
+    if (!fft)
+        return false;
+
+    numChannels = channels;
+    sampleRate = rate;
+    segmentLen = newSegmentLen;
+    averages = newAverages;
+    bands = newBands;
+    numBins = fft->getNumBins();
+
+    //Bin k covers [k - 1/2, k + 1/2) bins, clipped to [0, Nyquist], so DC and
+    //Nyquist are half as wide and aren't doubled by the one sided scaling
+    const int nyquistBin = segmentLen / 2;
+    binScale.resize(numBins);
+    for (int k = 0; k < numBins; k++) {
+        bool edge = (k == 0) || (k == nyquistBin && segmentLen % 2 == 0);
+        binScale[k] = (float)((edge ? 1.0 : 2.0) / (segmentLen * fft->getWindowPower()));
+    }
+
+    const double binWidth = (double)sampleRate / segmentLen;
+    const double nyquist = nyquistBin * binWidth + (segmentLen % 2 ? binWidth / 2 : 0);
+    firstBin.resize(bands.size());
+    binWeights.resize(bands.size());
+    for (size_t b = 0; b < bands.size(); b++) {
+        binWeights[b].clear();
+        firstBin[b] = std::max(0, (int)floor(bands[b].low / binWidth + 0.5));
+        for (int k = firstBin[b]; k < numBins; k++) {
+            double binLow = std::max(0.0, (k - 0.5) * binWidth);
+            double binHigh = std::min(nyquist, (k + 0.5) * binWidth);
+            if (binLow >= bands[b].high)
+                break;
+            double inside = std::min(binHigh, (double)bands[b].high) - std::max(binLow, (double)bands[b].low);
+            binWeights[b].push_back((float)std::max(0.0, inside / (binHigh - binLow)));
+        }
+    }
+
+    offsets.resize(numChannels);
+    slopes.resize(numChannels);
+    periodogram.resize((size_t)numChannels * numBins);
+    psd.assign((size_t)numChannels * numBins, 0.f);
+    pairs.clear();
+    if (!ring.setup(numChannels, segmentLen, DETREND_MEAN))
+        return false;
+    reset();
+    hop = newHop;
+    return true;
+}
+
+bool ofxWelchPSD::setDetrend(ofxDetrendMode detrend, float highpassHz)
+{
+    bool ok = ring.setup(numChannels, segmentLen, detrend, highpassHz, sampleRate);
+    reset();
+    return ok;
+}
+
+bool ofxWelchPSD::setPairs(const std::vector<ofxChannelPair>& newPairs, float newAverages)
+{
+    pairs.clear();
+    if (newAverages < 1)
+        return false;
+    for (size_t p = 0; p < newPairs.size(); p++) {
+        if (newPairs[p].a < 0 || newPairs[p].a >= numChannels || newPairs[p].b < 0 || newPairs[p].b >= numChannels)
+            return false;
+    }
+
+    pairs = newPairs;
+    pairAverages = newAverages;
+    spectra.resize((size_t)numChannels * numBins * 2);
+    pairAuto.assign((size_t)numChannels * numBins, 0.f);
+    cross.assign(pairs.size() * numBins * 2, 0.f);
+    reset();
+    return true;
+}
+
+void ofxWelchPSD::reset()
+{
+    ring.reset();
+    std::fill(psd.begin(), psd.end(), 0.f);
+    std::fill(pairAuto.begin(), pairAuto.end(), 0.f);
+    std::fill(cross.begin(), cross.end(), 0.f);
+    sinceFrame = 0;
+    segments = 0;
+}
+
+size_t ofxWelchPSD::process(const float* in, size_t inStride, size_t n, float* bandPower, size_t* frameIndex,
+                            float* pairFeatures, const unsigned char* reject)
+{
+    if (hop == 0)
+        return 0;
+
+    size_t frames = 0;
+    for (size_t t = 0; t < n; t++) {
+        ring.push(in + t * inStride);
+        sinceFrame++;
+
+        if (ring.isFull() && sinceFrame >= hop) {
+            if (!reject || !reject[t])
+                addSegment();
+            computeFrame(bandPower + frames * getFrameStride());
+            if (pairFeatures && !pairs.empty())
+                computePairFeatures(pairFeatures + frames * getPairFrameStride());
+            if (frameIndex)
+                frameIndex[frames] = t;
+            frames++;
+            sinceFrame = 0;
+        }
+    }
+    return frames;
+}
+
+void ofxWelchPSD::addSegment()
+{
+    ring.getTrend(&offsets[0], &slopes[0]);
+    const float* trendSlopes = ring.getDetrend() == DETREND_LINEAR ? &slopes[0] : NULL;
+    if (pairs.empty()) {
+        fft->power(ring.getWindow(), 1, ring.getDistance(), &offsets[0], &periodogram[0], numBins, trendSlopes);
+    } else {
+        //Keep the phases for the cross-spectra, the powers come from the same FFT
+        fft->transform(ring.getWindow(), 1, ring.getDistance(), &offsets[0], (fftwf_complex*)&spectra[0], numBins,
+                       trendSlopes);
+        for (size_t i = 0; i < periodogram.size(); i++)
+            periodogram[i] = spectra[2 * i] * spectra[2 * i] + spectra[2 * i + 1] * spectra[2 * i + 1];
+    }
+
+    //1/segments while filling up makes the start a plain Welch mean instead
+    //of an average that creeps up from zero
+    segments++;
+    const float weight = 1.f / std::min((float)segments, averages);
+    const float* scale = &binScale[0];
+    for (int c = 0; c < numChannels; c++) {
+        const float* p = &periodogram[(size_t)c * numBins];
+        float* avg = &psd[(size_t)c * numBins];
+        for (int k = 0; k < numBins; k++)
+            avg[k] += weight * (p[k] * scale[k] - avg[k]);
+    }
+
+    if (!pairs.empty())
+        addPairSegment();
+}
+
+void ofxWelchPSD::addPairSegment()
+{
+    const float weight = 1.f / std::min((float)segments, pairAverages);
+    const float* scale = &binScale[0];
+    for (int c = 0; c < numChannels; c++) {
+        const float* p = &periodogram[(size_t)c * numBins];
+        float* avg = &pairAuto[(size_t)c * numBins];
+        for (int k = 0; k < numBins; k++)
+            avg[k] += weight * (p[k] * scale[k] - avg[k]);
+    }
+
+    for (size_t p = 0; p < pairs.size(); p++) {
+        const float* x = &spectra[(size_t)pairs[p].a * numBins * 2];
+        const float* y = &spectra[(size_t)pairs[p].b * numBins * 2];
+        float* avg = &cross[p * numBins * 2];
+        for (int k = 0; k < numBins; k++) {
+            //x * conj(y)
+            float re = x[2 * k] * y[2 * k] + x[2 * k + 1] * y[2 * k + 1];
+            float im = x[2 * k + 1] * y[2 * k] - x[2 * k] * y[2 * k + 1];
+            avg[2 * k] += weight * (re * scale[k] - avg[2 * k]);
+            avg[2 * k + 1] += weight * (im * scale[k] - avg[2 * k + 1]);
+        }
+    }
+}
+
+void ofxWelchPSD::computeFrame(float* bandPower)
+{
+    const int numBands = getNumBands();
+    for (int c = 0; c < numChannels; c++) {
+        const float* avg = &psd[(size_t)c * numBins];
+        for (int b = 0; b < numBands; b++) {
+            const float* w = binWeights[b].empty() ? NULL : &binWeights[b][0];
+            const float* p = avg + firstBin[b];
+            double power = 0;
+            for (size_t i = 0; i < binWeights[b].size(); i++)
+                power += w[i] * p[i];
+            bandPower[c * numBands + b] = (float)power;
+        }
+    }
+}
+
+void ofxWelchPSD::computePairFeatures(float* features)
+{
+    const int numBands = getNumBands();
+    for (size_t p = 0; p < pairs.size(); p++) {
+        const float* pa = &pairAuto[(size_t)pairs[p].a * numBins];
+        const float* pb = &pairAuto[(size_t)pairs[p].b * numBins];
+        const float* c = &cross[p * numBins * 2];
+        for (int b = 0; b < numBands; b++) {
+            double coherence = 0, weights = 0, powerA = 0, powerB = 0;
+            for (size_t i = 0; i < binWeights[b].size(); i++) {
+                const int k = firstBin[b] + (int)i;
+                const double w = binWeights[b][i];
+                const double auto2 = (double)pa[k] * pb[k];
+                if (auto2 > 0)
+                    coherence += w * ((double)c[2 * k] * c[2 * k] + (double)c[2 * k + 1] * c[2 * k + 1]) / auto2;
+                weights += w;
+                powerA += w * pa[k];
+                powerB += w * pb[k];
+            }
+
+            float* out = features + getPairFeatureIndex((int)p, b);
+            out[PAIR_COHERENCE] = weights > 0 ? (float)(coherence / weights) : 0.f;
+            out[PAIR_ASYMMETRY] = (powerA > 0 && powerB > 0) ? (float)(log(powerB) - log(powerA)) : 0.f;
+        }
+    }
+}
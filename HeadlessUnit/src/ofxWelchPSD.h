@@ -0,0 +1,127 @@
+//
+//  ofxWelchPSD.h
+//  barbicanExhibit
+//
+//  Welch power spectrum kept up to date one segment at a time. Every hop
+//  samples the newest segment (overlapping the previous ones by
+//  segmentLen - hop) is windowed and transformed, and its periodogram is
+//  folded into an exponential average, so a new estimate costs one batched
+//  FFT however long the average is. Bands are integrated in Hz: a bin that
+//  straddles a band edge counts with the fraction of its width inside the
+//  band, so the bands mean the same thing at any segment length or rate.
+//  Takes the same setup() and process() arguments as ofxSlidingSTFT.
+//
+//  Given channel pairs, the same FFTs also feed running cross-spectra, one
+//  complex multiply-accumulate per bin per pair, for each pair's
+//  magnitude squared coherence and power asymmetry per band.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "ofxBatchFft.h"
+#include "ofxAnalysisRing.h"
+
+//Segments in the average by default (the exponential average's time constant)
+#define WELCH_DEFAULT_AVERAGES 8
+
+//Two channels compared by the pair features, e.g. left and right hemisphere
+struct ofxChannelPair {
+    int a;
+    int b;
+    const char* name; //for logs, may be NULL
+};
+
+//Per pair and band, at getPairFeatureIndex(pair, band) + one of these
+enum ofxPairFeature {
+    PAIR_COHERENCE,  //magnitude squared coherence, 0..1, averaged over the band's bins
+    PAIR_ASYMMETRY,  //ln(power of b) - ln(power of a) in the band
+    NUM_PAIR_FEATURES
+};
+
+class ofxWelchPSD {
+public:
+    ofxWelchPSD();
+
+    //Segments of segmentLen samples, one every hop. averages sets how many
+    //segments the running average remembers; until that many are in, it's
+    //a plain mean of the segments so far.
+    bool setup(int numChannels, float sampleRate, int segmentLen, int hop, ofxSpectralWindow window,
+               const std::vector<ofxFrequencyBand>& bands, float averages = WELCH_DEFAULT_AVERAGES);
+
+    //Same as ofxSlidingSTFT::setDetrend(), segments are demeaned by default.
+    //Empties the ring and forgets the average.
+    bool setDetrend(ofxDetrendMode detrend, float highpassHz = 0);
+
+    //Empties the ring and forgets the average
+    void reset();
+
+    //Turns on the pair features. Coherence needs many roughly independent
+    //segments, so pairs have their own, usually longer, average: with
+    //heavily overlapping segments a short one reads close to 1 for anything.
+    //An empty list turns them off.
+    bool setPairs(const std::vector<ofxChannelPair>& pairs, float averages);
+
+    //Same layout as ofxSlidingSTFT::process(), one frame per new segment.
+    //With pairs set and pairFeatures not NULL, frame f's features go to
+    //pairFeatures[f*getPairFrameStride() + getPairFeatureIndex(pair, band) + feature].
+    //A segment ending on a sample t with reject[t] != 0 (e.g. artifact flags)
+    //stays out of the averages, so it can't linger in later frames; its frame
+    //repeats the averages as they were.
+    size_t process(const float* in, size_t inStride, size_t n, float* bandPower, size_t* frameIndex = NULL,
+                   float* pairFeatures = NULL, const unsigned char* reject = NULL);
+
+    size_t getMaxFrames(size_t n) const { return hop > 0 ? n / hop + 1 : 0; }
+    int getFrameStride() const { return numChannels * getNumBands(); }
+    int getNumChannels() const { return numChannels; }
+    int getNumBands() const { return (int)bands.size(); }
+    int getWindowLength() const { return segmentLen; }
+    int getHop() const { return hop; }
+    int getNumSegments() const { return segments; }
+    int getNumPairs() const { return (int)pairs.size(); }
+    int getPairFrameStride() const { return getNumPairs() * getNumBands() * NUM_PAIR_FEATURES; }
+    int getPairFeatureIndex(int pair, int band) const { return (pair * getNumBands() + band) * NUM_PAIR_FEATURES; }
+
+    //Averaged spectrum of a channel, getNumBins() values of mean square
+    //power per bin. Bin k is centred on k*getBinWidth() Hz.
+    const float* getSpectrum(int channel) const { return &psd[(size_t)channel * numBins]; }
+    int getNumBins() const { return numBins; }
+    float getBinWidth() const { return sampleRate / segmentLen; }
+
+private:
+    void addSegment();
+    void addPairSegment();
+    void computeFrame(float* bandPower);
+    void computePairFeatures(float* features);
+
+    int numChannels;
+    float sampleRate;
+    int segmentLen;
+    int hop;
+    int numBins;
+    float averages;
+    std::vector<ofxFrequencyBand> bands;
+
+    //Bins firstBin[b] .. firstBin[b]+binWeights[b].size()-1 make up band b,
+    //weighted by how much of each bin lies inside it
+    std::vector<int> firstBin;
+    std::vector<std::vector<float> > binWeights;
+
+    ofxAnalysisRing ring;
+    int sinceFrame;
+    int segments;             //segments averaged so far
+
+    ofxBatchFft* fft;
+    std::vector<float> binScale; //|X|^2 to mean square, one sided
+    std::vector<float> offsets;  //[channel], the newest segment's trend
+    std::vector<float> slopes;
+    std::vector<float> periodogram; //[channel][bin], the newest segment
+    std::vector<float> psd;      //[channel][bin], the running average
+
+    std::vector<ofxChannelPair> pairs;
+    float pairAverages;
+    std::vector<float> spectra;  //[channel][bin][re, im], the newest segment, only with pairs
+    std::vector<float> pairAuto; //[channel][bin], power averaged like the cross-spectra
+    std::vector<float> cross;    //[pair][bin][re, im], running X_a * conj(X_b)
+};
@@ -0,0 +1,465 @@
+//
+//  sessionTool.cpp
+//  barbicanExhibit
+//
+//  Offline counterpart of visualize.py's butter_bandpass_filter and stft for
+//  recorded sessions. Memory-maps a session CSV, runs a zero-phase
+//  (forward-backward) Butterworth bandpass over every channel and writes a
+//  Hamming STFT power spectrogram. Both results are .npy files, so Python
+//  can map them without reading them in:
+//
+//      filtered = np.load("out.filtered.npy", mmap_mode="r")  #[sample, channel]
+//      spec = np.load("out.spectrogram.npy", mmap_mode="r")   #[frame, channel, bin]
+//
+//  Spectrogram bin k is k*rate/window Hz. Frame f covers samples
+//  [f*hop, f*hop + window), and each value is that bin's share of the
+//  frame's mean square, same scaling as HeadlessUnit's band powers.
+//
+//  The filter is ofxButterworthBank's, the properly cascaded version of
+//  ofxInlineFilter's exstrom bwbpf design, and the FFTs are ofxBatchFft's,
+//  all channels per call.
+//  Channels are filtered on separate threads, then the frames are split into
+//  blocks across threads. Build (POSIX only, from this folder):
+//
+//      g++ -std=c++11 -O3 -march=native -pthread -I../HeadlessUnit/src sessionTool.cpp
+//          ../HeadlessUnit/src/ofxButterworthBank.cpp ../HeadlessUnit/src/ofxBatchFft.cpp
+//          -lfftw3f -o sessionTool
+//
+//  The defaults read HeadlessUnit's session log, one row per decimated
+//  sample at ANALYSIS_RATE (125 Hz):
+//
+//      0          timestamp, ns
+//      1          artifact flags of the window ending on the sample
+//      2, 3       the analysis channels, raw ADC counts
+//      4 ..       every filter bank lane's filtered signal, then every
+//                 lane's envelope power (EEG_BANDS lowest first, channels
+//                 within a band)
+//
+//  Usage: sessionTool session.csv out [options]
+//      --columns 2,3     CSV columns to read, from 0 (default 2,3)
+//      --rate 125        sample rate in Hz (default 125)
+//      --band 0.5 45     bandpass edges in Hz, below rate/2 (default 0.5 45)
+//      --order 4         filter poles, a multiple of 4 (default 4)
+//      --window 125      STFT window in samples (default 1 s)
+//      --hop 125         STFT hop in samples (default 1 s)
+//      --scale 0.02232   multiply the samples first, e.g. COUNT_TO_MICROVOLT for uV (default 1)
+//      --threads n       worker threads (default all cores)
+//
+//  Lines that don't have a number in every chosen column (headers, prompts)
+//  are skipped.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofxButterworthBank.h"
+#include "ofxBatchFft.h"
+
+struct Options {
+    std::vector<int> columns;
+    double rate;
+    double low, high;
+    int order;
+    int window;
+    int hop;
+    float scale;
+    int threads;
+};
+
+//A read-only or read-write file mapping, unmapped when it goes out of scope
+class MappedFile {
+public:
+    MappedFile(): data(NULL), size(0), fd(-1) {}
+    ~MappedFile() { close(); }
+
+    bool openRead(const char* path)
+    {
+        fd = ::open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+            return false;
+        size = (size_t)st.st_size;
+        if (size == 0)
+            return true;
+        data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+            return false;
+        }
+        madvise(data, size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    bool create(const char* path, size_t newSize)
+    {
+        fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, (off_t)newSize) != 0)
+            return false;
+        size = newSize;
+        data = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (data)
+            munmap(data, size);
+        if (fd >= 0)
+            ::close(fd);
+        data = NULL;
+        fd = -1;
+    }
+
+    char* data;
+    size_t size;
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    int fd;
+};
+
+//strtod needs a terminated string, the mapping isn't one. Parses a plain
+//decimal number with optional sign, fraction and exponent, stops at end.
+static bool parseNumber(const char*& p, const char* end, double& value)
+{
+    const char* s = p;
+    while (s < end && (*s == ' ' || *s == '\t'))
+        s++;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        negative = (*s++ == '-');
+
+    double mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++, digits++)
+        mantissa = mantissa * 10 + (*s - '0');
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits++, exponent--)
+            mantissa = mantissa * 10 + (*s - '0');
+    }
+    if (digits == 0)
+        return false;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        bool negativeExp = false;
+        if (e < end && (*e == '-' || *e == '+'))
+            negativeExp = (*e++ == '-');
+        int expDigits = 0, exp = 0;
+        for (; e < end && *e >= '0' && *e <= '9'; e++, expDigits++)
+            exp = exp * 10 + (*e - '0');
+        if (expDigits > 0) {
+            exponent += negativeExp ? -exp : exp;
+            s = e;
+        }
+    }
+
+    value = mantissa * pow(10.0, exponent);
+    if (negative)
+        value = -value;
+    p = s;
+    return true;
+}
+
+//Reads the chosen columns of every numeric row, interleaved [sample][channel]
+static size_t readSession(const MappedFile& file, const Options& opt, std::vector<float>& samples)
+{
+    const int numChannels = (int)opt.columns.size();
+    const int lastColumn = *std::max_element(opt.columns.begin(), opt.columns.end());
+    std::vector<float> row(numChannels);
+    std::vector<bool> found(numChannels);
+
+    const char* p = file.data;
+    const char* end = file.data + file.size;
+    //A sample is 8 to 20 characters of CSV, start with a reasonable guess
+    samples.clear();
+    samples.reserve(file.size / 16);
+
+    while (p < end) {
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (!lineEnd)
+            lineEnd = end;
+
+        std::fill(found.begin(), found.end(), false);
+        int column = 0;
+        const char* field = p;
+        while (field <= lineEnd && column <= lastColumn) {
+            const char* fieldEnd = (const char*)memchr(field, ',', lineEnd - field);
+            if (!fieldEnd)
+                fieldEnd = lineEnd;
+            for (int c = 0; c < numChannels; c++) {
+                if (opt.columns[c] != column)
+                    continue;
+                const char* q = field;
+                double value;
+                if (parseNumber(q, fieldEnd, value)) {
+                    row[c] = (float)value * opt.scale;
+                    found[c] = true;
+                }
+            }
+            field = fieldEnd + 1;
+            column++;
+        }
+
+        if (std::find(found.begin(), found.end(), false) == found.end())
+            samples.insert(samples.end(), row.begin(), row.end());
+        p = lineEnd + 1;
+    }
+    return samples.size() / numChannels;
+}
+
+//Forward-backward filtering of one channel, with an odd extension at both
+//ends like scipy's filtfilt so the edges don't ring
+static void filtfiltChannel(const Options& opt, const float* in, size_t numSamples, int stride,
+                            float* out, bool& ok)
+{
+    std::vector<ofxFrequencyBand> band(1);
+    band[0].low = (float)opt.low;
+    band[0].high = (float)opt.high;
+    band[0].name = NULL;
+    ofxButterworthBank bank;
+    ok = bank.setup(1, opt.order, opt.rate, band);
+    if (!ok)
+        return;
+
+    const size_t pad = std::min(numSamples - 1, (size_t)3 * (opt.order + 1));
+    const size_t total = numSamples + 2 * pad;
+    std::vector<float> x(total), y(total);
+    for (size_t t = 0; t < numSamples; t++)
+        x[pad + t] = in[t * stride];
+    const float first = x[pad], last = x[pad + numSamples - 1];
+    for (size_t i = 1; i <= pad; i++) {
+        x[pad - i] = 2 * first - x[pad + i];
+        x[pad + numSamples - 1 + i] = 2 * last - x[pad + numSamples - 1 - i];
+    }
+
+    //Each pass starts from zero state, so start its input at zero too instead
+    //of stepping from 0 to the DC offset. The bandpass drops the constant
+    //anyway, this just drops its transient (scipy uses lfilter_zi for this).
+    const float forwardStart = x[0];
+    for (size_t t = 0; t < total; t++)
+        x[t] -= forwardStart;
+    bank.process(&x[0], 1, total, &y[0], 1);
+    std::reverse(y.begin(), y.end());
+    const float backwardStart = y[0];
+    for (size_t t = 0; t < total; t++)
+        y[t] -= backwardStart;
+    bank.reset();
+    bank.process(&y[0], 1, total, &x[0], 1);
+    std::reverse(x.begin(), x.end());
+
+    for (size_t t = 0; t < numSamples; t++)
+        out[t * stride] = x[pad + t];
+}
+
+//Minimal .npy (format 1.0) header for a little endian float32 C array,
+//padded so the data starts 64 byte aligned
+static std::string npyHeader(const std::vector<size_t>& shape)
+{
+    std::string dict = "{'descr': '<f4', 'fortran_order': False, 'shape': (";
+    for (size_t i = 0; i < shape.size(); i++) {
+        char dim[32];
+        snprintf(dim, sizeof(dim), "%zu,%s", shape[i], i + 1 < shape.size() ? " " : "");
+        dict += dim;
+    }
+    dict += "), }";
+
+    size_t total = 10 + dict.size() + 1;
+    total = (total + 63) / 64 * 64;
+    dict.append(total - 10 - dict.size() - 1, ' ');
+    dict += '\n';
+
+    std::string header("\x93NUMPY\x01\x00", 8);
+    header += (char)(dict.size() & 0xff);
+    header += (char)(dict.size() >> 8);
+    return header + dict;
+}
+
+static bool createNpy(MappedFile& file, const std::string& path, const std::vector<size_t>& shape, float*& data)
+{
+    std::string header = npyHeader(shape);
+    size_t count = 1;
+    for (size_t i = 0; i < shape.size(); i++)
+        count *= shape[i];
+    if (!file.create(path.c_str(), header.size() + count * sizeof(float))) {
+        fprintf(stderr, "Can't create %s\n", path.c_str());
+        return false;
+    }
+    memcpy(file.data, header.data(), header.size());
+    data = (float*)(file.data + header.size());
+    return true;
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt)
+{
+    opt.columns.clear();
+    opt.columns.push_back(2);
+    opt.columns.push_back(3);
+    opt.rate = 125;
+    opt.low = 0.5;
+    opt.high = 45;
+    opt.order = 4;
+    opt.window = 0;
+    opt.hop = 0;
+    opt.scale = 1;
+    opt.threads = (int)std::thread::hardware_concurrency();
+
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--columns" && hasValue) {
+            opt.columns.clear();
+            for (char* s = argv[++i]; *s; ) {
+                opt.columns.push_back((int)strtol(s, &s, 10));
+                if (*s == ',')
+                    s++;
+                else if (*s)
+                    return false;
+            }
+        } else if (arg == "--rate" && hasValue) {
+            opt.rate = atof(argv[++i]);
+        } else if (arg == "--band" && i + 2 < argc) {
+            opt.low = atof(argv[++i]);
+            opt.high = atof(argv[++i]);
+        } else if (arg == "--order" && hasValue) {
+            opt.order = atoi(argv[++i]);
+        } else if (arg == "--window" && hasValue) {
+            opt.window = atoi(argv[++i]);
+        } else if (arg == "--hop" && hasValue) {
+            opt.hop = atoi(argv[++i]);
+        } else if (arg == "--scale" && hasValue) {
+            opt.scale = (float)atof(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            opt.threads = atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+
+    if (opt.window <= 0)
+        opt.window = (int)opt.rate;
+    if (opt.hop <= 0)
+        opt.hop = opt.window;
+    opt.threads = std::max(1, opt.threads);
+    return !opt.columns.empty() && opt.rate > 0 && opt.window >= 2;
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (argc < 3 || !parseArgs(argc, argv, opt)) {
+        fprintf(stderr, "Usage: %s session.csv out [--columns 2,3] [--rate 125] [--band 0.5 45] [--order 4]\n"
+                        "       [--window n] [--hop n] [--scale 1] [--threads n]\n", argv[0]);
+        return 1;
+    }
+    if (opt.low <= 0 || opt.high <= opt.low || opt.high >= opt.rate / 2) {
+        fprintf(stderr, "The band %g-%g Hz has to lie between 0 and %g Hz, half the rate\n", opt.low, opt.high, opt.rate / 2);
+        return 1;
+    }
+    const std::string outPrefix = argv[2];
+    const int numChannels = (int)opt.columns.size();
+
+    MappedFile session;
+    if (!session.openRead(argv[1])) {
+        fprintf(stderr, "Can't read %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<float> samples;
+    const size_t numSamples = readSession(session, opt, samples);
+    session.close();
+    printf("Read %zu samples of %i channels\n", numSamples, numChannels);
+    if (numSamples < 2) {
+        fprintf(stderr, "Not enough samples\n");
+        return 1;
+    }
+
+    //Zero-phase bandpass, one thread per channel at a time
+    MappedFile filteredFile;
+    float* filtered;
+    std::vector<size_t> filteredShape;
+    filteredShape.push_back(numSamples);
+    filteredShape.push_back(numChannels);
+    if (!createNpy(filteredFile, outPrefix + ".filtered.npy", filteredShape, filtered))
+        return 1;
+
+    std::vector<char> channelOk(numChannels, 0);
+    for (int first = 0; first < numChannels; first += opt.threads) {
+        std::vector<std::thread> workers;
+        for (int c = first; c < std::min(numChannels, first + opt.threads); c++) {
+            workers.push_back(std::thread([&, c]() {
+                bool ok;
+                filtfiltChannel(opt, &samples[c], numSamples, numChannels, filtered + c, ok);
+                channelOk[c] = ok;
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+    if (std::find(channelOk.begin(), channelOk.end(), 0) != channelOk.end()) {
+        fprintf(stderr, "Can't design a %i pole %g-%g Hz bandpass at %g Hz\n", opt.order, opt.low, opt.high, opt.rate);
+        return 1;
+    }
+    std::vector<float>().swap(samples);
+
+    //Spectrogram, contiguous blocks of frames per thread, all channels of a
+    //frame in one batched FFT straight out of the interleaved samples
+    ofxBatchFft* fft = ofxBatchFft::get(opt.window, SPECTRAL_WINDOW_HAMMING, numChannels);
+    if (!fft) {
+        fprintf(stderr, "Can't plan a %i point FFT\n", opt.window);
+        return 1;
+    }
+    const size_t numFrames = numSamples >= (size_t)opt.window ? (numSamples - opt.window) / opt.hop + 1 : 0;
+    const int numBins = fft->getNumBins();
+
+    MappedFile spectrogramFile;
+    float* spectrogram;
+    std::vector<size_t> spectrogramShape;
+    spectrogramShape.push_back(numFrames);
+    spectrogramShape.push_back(numChannels);
+    spectrogramShape.push_back(numBins);
+    if (!createNpy(spectrogramFile, outPrefix + ".spectrogram.npy", spectrogramShape, spectrogram))
+        return 1;
+
+    //Same one sided mean square scaling as ofxWelchPSD
+    std::vector<float> binScale(numBins);
+    for (int k = 0; k < numBins; k++) {
+        bool edge = (k == 0) || (k == opt.window / 2 && opt.window % 2 == 0);
+        binScale[k] = (float)((edge ? 1.0 : 2.0) / (opt.window * fft->getWindowPower()));
+    }
+
+    const size_t framesPerThread = (numFrames + opt.threads - 1) / opt.threads;
+    std::vector<std::thread> workers;
+    for (size_t begin = 0; begin < numFrames; begin += framesPerThread) {
+        const size_t end = std::min(numFrames, begin + framesPerThread);
+        workers.push_back(std::thread([&, begin, end]() {
+            for (size_t f = begin; f < end; f++) {
+                float* frame = spectrogram + f * numChannels * numBins;
+                fft->power(filtered + f * opt.hop * numChannels, numChannels, 1, NULL, frame, numBins);
+                for (int c = 0; c < numChannels; c++)
+                    for (int k = 0; k < numBins; k++)
+                        frame[c * numBins + k] *= binScale[k];
+            }
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    printf("Wrote %s.filtered.npy (%zu x %i) and %s.spectrogram.npy (%zu x %i x %i), %g Hz per bin\n",
+           outPrefix.c_str(), numSamples, numChannels, outPrefix.c_str(), numFrames, numChannels, numBins,
+           opt.rate / opt.window);
+    return 0;
+}
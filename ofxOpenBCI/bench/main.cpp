@@ -0,0 +1,104 @@
+//
+//  Decoder microbenchmark for ofxOpenBCI. Does not need openFrameworks.
+//
+//  Build and run from the ofxOpenBCI folder, e.g.
+//      c++ -O3 -std=c++11 -mavx2 -Isrc bench/main.cpp src/ofxOpenBCIDecode.cpp -o decodeBench && ./decodeBench
+//  Drop -mavx2 (or use -mssse3) to measure the other code paths.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+#include "ofxOpenBCIDecode.h"
+
+using namespace std;
+
+const size_t NUM_FRAMES = 4096;   //about 8 seconds of data at 500Hz
+const int NUM_REPEATS = 2000;
+
+//This is the per-sample path ofxOpenBCI has always used: one call per
+//channel, a branch to sign extend, and the scaling done later by the caller
+static int interpret24bitAsInt32(const unsigned char byteArray[])
+{
+    int newInt = (
+        ((0xFF & byteArray[0]) << 16) |
+        ((0xFF & byteArray[1]) << 8) |
+        (0xFF & byteArray[2]));
+    if ((newInt & 0x00800000) > 0) {
+        newInt |= 0xFF000000;
+    } else {
+        newInt &= 0x00FFFFFF;
+    }
+    return newInt;
+}
+
+static void decodePerCall(const unsigned char* frames, size_t nFrames, float* out, size_t outStride, float scale)
+{
+    for (size_t i = 0; i < nFrames; i++) {
+        const unsigned char* packet = frames + i * OPENBCI_PACKET_LEN;
+        float values[OPENBCI_NUM_CHANNELS];
+        int startIdx = 2;
+        for (int ch = 0; ch < OPENBCI_NUM_CHANNELS; ch++) {
+            values[ch] = interpret24bitAsInt32(&packet[startIdx]);
+            startIdx += 3;
+        }
+        for (int ch = 0; ch < OPENBCI_NUM_CHANNELS; ch++)
+            out[ch * outStride + i] = values[ch] * scale;
+    }
+}
+
+typedef void (*decodeFn)(const unsigned char*, size_t, float*, size_t, float);
+
+static double run(const char* name, decodeFn fn, const vector<unsigned char>& frames, vector<float>& out)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < NUM_REPEATS; r++)
+        fn(&frames[0], NUM_FRAMES, &out[0], NUM_FRAMES, COUNT_TO_MICROVOLT);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double bytesPerSecond = (double)frames.size() * NUM_REPEATS / seconds;
+    printf("%-18s %8.1f MB/s  %8.2f Mpackets/s\n", name, bytesPerSecond / 1e6, bytesPerSecond / OPENBCI_PACKET_LEN / 1e6);
+    return bytesPerSecond;
+}
+
+int main()
+{
+    vector<unsigned char> frames(NUM_FRAMES * OPENBCI_PACKET_LEN);
+    for (size_t i = 0; i < NUM_FRAMES; i++) {
+        unsigned char* packet = &frames[i * OPENBCI_PACKET_LEN];
+        packet[0] = OPENBCI_BYTE_START;
+        packet[1] = (unsigned char)i;
+        for (int b = 2; b < OPENBCI_PACKET_LEN - 1; b++)
+            packet[b] = (unsigned char)rand();
+        packet[OPENBCI_PACKET_LEN - 1] = OPENBCI_BYTE_END;
+    }
+
+    vector<float> reference(NUM_FRAMES * OPENBCI_NUM_CHANNELS);
+    vector<float> out(NUM_FRAMES * OPENBCI_NUM_CHANNELS);
+
+    //Every path must agree exactly before we bother timing it
+    decodePerCall(&frames[0], NUM_FRAMES, &reference[0], NUM_FRAMES, COUNT_TO_MICROVOLT);
+    ofxOpenBCIDecodeFrames(&frames[0], NUM_FRAMES, &out[0], NUM_FRAMES, COUNT_TO_MICROVOLT);
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] != reference[i]) {
+            printf("Mismatch at %i: %f vs %f\n", (int)i, out[i], reference[i]);
+            return 1;
+        }
+    }
+
+#if defined(__AVX2__)
+    const char* simdName = "batch (AVX2)";
+#elif defined(__SSSE3__)
+    const char* simdName = "batch (SSSE3)";
+#else
+    const char* simdName = "batch (no SIMD)";
+#endif
+
+    double perCall = run("per-call", decodePerCall, frames, out);
+    run("batch (scalar)", ofxOpenBCIDecodeFramesScalar, frames, out);
+    double batch = run(simdName, ofxOpenBCIDecodeFrames, frames, out);
+    printf("speedup over per-call: %.1fx\n", batch / perCall);
+    return 0;
+}
@@ -0,0 +1,163 @@
+//
+//  Command line front end for ofxOpenBCISimulator. Does not need openFrameworks.
+//
+//  Build from the ofxOpenBCI folder:
+//      c++ -O2 -std=c++11 -pthread -Isrc -Isimulator simulator/*.cpp src/ofxOpenBCIFramer.cpp src/ofxOpenBCIDecode.cpp -o openbciSimulator
+//
+//  ./openbciSimulator [--rate 250] [--channels 8] [--corrupt 0.0001] [--stream]
+//      Prints the PTY path to open in place of /dev/tty.usb* and serves it until Ctrl-C.
+//  ./openbciSimulator --bench 10 [--rate 16000] ...
+//      Streams to itself for 10 seconds through the same framer and decoder
+//      ofxOpenBCI uses and reports parser throughput and end-to-end latency.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "ofxOpenBCISimulator.h"
+
+using namespace std;
+
+static volatile sig_atomic_t keepRunning = 1;
+
+static void onSignal(int)
+{
+    keepRunning = 0;
+}
+
+static uint64_t steadyNowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int serve(ofxOpenBCISimulator& simulator)
+{
+    printf("Virtual OpenBCI board on %s\n", simulator.getPortName().c_str());
+    fflush(stdout);
+
+    while (keepRunning) {
+        sleep(1);
+        printf("%s, %llu packets sent, %llu dropped\n",
+               simulator.isStreaming() ? "streaming" : "idle",
+               (unsigned long long)simulator.getPacketsSent(),
+               (unsigned long long)simulator.getPacketsDropped());
+        fflush(stdout);
+    }
+    return 0;
+}
+
+//Reads the PTY like ofxOpenBCI does: poll, read straight into the framer,
+//decode every packet, watch the sample counter
+static int bench(ofxOpenBCISimulator& simulator, double seconds)
+{
+    int fd = open(simulator.getPortName().c_str(), O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+
+    char start = 'b';
+    if (write(fd, &start, 1) != 1)
+        return 1;
+
+    ofxOpenBCIFramer framer;
+    vector<uint64_t> latencies;
+    latencies.reserve(1 << 20);
+    float values[OPENBCI_NUM_CHANNELS];
+    uint64_t packets = 0, bytes = 0, lost = 0;
+    int lastIndex = -1;
+
+    uint64_t began = steadyNowNs();
+    uint64_t end = began + (uint64_t)(seconds * 1e9);
+
+    while (keepRunning && steadyNowNs() < end) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+
+        size_t space;
+        unsigned char* dst = framer.writeSpan(space);
+        ssize_t n = read(fd, dst, space);
+        if (n <= 0)
+            continue;
+        framer.commit(n);
+        bytes += n;
+        uint64_t now = steadyNowNs();
+
+        const unsigned char* packet;
+        while ((packet = framer.nextFrame()) != NULL) {
+            ofxOpenBCIDecodeFramesScalar(packet, 1, values, 1);
+            if (lastIndex >= 0)
+                lost += (packet[1] - lastIndex + 255) % 256;
+            lastIndex = packet[1];
+            uint64_t sent = simulator.getSendTimeNs(packet[1]);
+            if (sent && sent <= now)
+                latencies.push_back(now - sent);
+            packets++;
+        }
+    }
+    double elapsed = (steadyNowNs() - began) / 1e9;
+    close(fd);
+
+    printf("parsed %llu packets in %.2fs: %.0f packets/s, %.2f MB/s\n",
+           (unsigned long long)packets, elapsed, packets / elapsed, bytes / elapsed / 1e6);
+    printf("lost %llu, framing errors %llu, simulator dropped %llu\n",
+           (unsigned long long)lost, (unsigned long long)framer.getFramingErrors(),
+           (unsigned long long)simulator.getPacketsDropped());
+    if (!latencies.empty()) {
+        sort(latencies.begin(), latencies.end());
+        printf("latency us: median %.1f, p99 %.1f, max %.1f\n",
+               latencies[latencies.size() / 2] / 1e3,
+               latencies[latencies.size() * 99 / 100] / 1e3,
+               latencies.back() / 1e3);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    ofxOpenBCISimulatorSettings settings;
+    double benchSeconds = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--rate") && hasValue) settings.sampleRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--channels") && hasValue) settings.numChannels = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--corrupt") && hasValue) settings.corruptionRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && hasValue) settings.seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--bench") && hasValue) benchSeconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--stream")) settings.streamOnStart = true;
+        else {
+            fprintf(stderr, "usage: %s [--rate Hz] [--channels n] [--corrupt p] [--seed n] [--stream] [--bench seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    ofxOpenBCISimulator simulator;
+    if (!simulator.start(settings)) {
+        perror("Could not open a pseudo-terminal");
+        return 1;
+    }
+
+    int result = benchSeconds > 0 ? bench(simulator, benchSeconds) : serve(simulator);
+    simulator.stop();
+    return result;
+}
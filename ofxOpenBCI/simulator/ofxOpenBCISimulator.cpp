@@ -0,0 +1,294 @@
+//
+//  ofxOpenBCISimulator.cpp
+//
+
+#include "ofxOpenBCISimulator.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <chrono>
+#include <vector>
+
+const int MAX_PACKETS_PER_WRITE = 64;  //so very high rates still get written in sensible chunks
+const float PINK_NOISE_UV = 2.5f;
+const float ALPHA_UV = 20.f;           //10Hz bursts, what the game rewards
+const float BETA_UV = 6.f;             //20Hz bursts
+const float BURSTS_PER_SECOND = 0.7f;
+const float BURST_ATTACK_SECONDS = 0.2f;
+const float TEST_SIGNAL_UV = 1875.f;   //like the ADS1299 internal test square wave
+const float UNFILTERED_DC_UV = 800.f;  //the board's offset until 'F' turns its filters on
+
+static uint64_t steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ofxOpenBCISimulator::ofxOpenBCISimulator(): masterFd(-1), slaveFd(-1)
+{
+    running.store(false);
+    streaming.store(false);
+    packetsSent.store(0);
+    packetsDropped.store(0);
+    for (int i = 0; i < 256; i++)
+        sendTimeNs[i].store(0);
+}
+
+ofxOpenBCISimulator::~ofxOpenBCISimulator()
+{
+    stop();
+}
+
+bool ofxOpenBCISimulator::start(const ofxOpenBCISimulatorSettings& newSettings)
+{
+    stop();
+    settings = newSettings;
+    if (settings.numChannels > OPENBCI_NUM_CHANNELS)
+        settings.numChannels = OPENBCI_NUM_CHANNELS;
+
+    masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) {
+        stop();
+        return false;
+    }
+    portName = ptsname(masterFd);
+    fcntl(masterFd, F_SETFL, fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+
+    //Hold the slave open ourselves so the line stays up between clients, and
+    //make it raw so 0x0A/0x0D in the binary stream are left alone
+    slaveFd = open(portName.c_str(), O_RDWR | O_NOCTTY);
+    if (slaveFd >= 0) {
+        struct termios tio;
+        tcgetattr(slaveFd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slaveFd, TCSANOW, &tio);
+    }
+
+    withAux = false;
+    filtersOn = false;
+    testSignal = false;
+    for (int ch = 0; ch < OPENBCI_NUM_CHANNELS; ch++)
+        channelOn[ch] = ch < settings.numChannels;
+    sampleCounter = 0;
+    sampleNumber = 0;
+    memset(pink, 0, sizeof(pink));
+    alphaEnvelope = betaEnvelope = 0;
+    alphaTarget = betaTarget = 0;
+    rng = settings.seed ? settings.seed : 1;
+    packetsSent.store(0);
+    packetsDropped.store(0);
+    pending.clear();
+    streaming.store(settings.streamOnStart);
+
+    running.store(true);
+    thread = std::thread(&ofxOpenBCISimulator::run, this);
+    return true;
+}
+
+void ofxOpenBCISimulator::stop()
+{
+    running.store(false);
+    if (thread.joinable())
+        thread.join();
+    if (slaveFd >= 0)
+        close(slaveFd);
+    if (masterFd >= 0)
+        close(masterFd);
+    slaveFd = masterFd = -1;
+    streaming.store(false);
+}
+
+void ofxOpenBCISimulator::run()
+{
+    uint64_t periodNs = (uint64_t)(1e9 / settings.sampleRate);
+    uint64_t nextPacketNs = steadyNowNs();
+    bool wasStreaming = false;
+
+    while (running.load()) {
+        unsigned char commands[64];
+        ssize_t n = read(masterFd, commands, sizeof(commands));
+        for (ssize_t i = 0; i < n; i++)
+            handleCommand(commands[i]);
+        flushPending();
+
+        uint64_t now = steadyNowNs();
+        bool isOn = streaming.load();
+        if (isOn && !wasStreaming)
+            nextPacketNs = now;  //don't try to catch up on time spent stopped
+        wasStreaming = isOn;
+
+        //Everything that has come due since last time goes out in one write
+        for (int k = 0; isOn && k < MAX_PACKETS_PER_WRITE && nextPacketNs <= now; k++) {
+            writePacket(now);
+            nextPacketNs += periodNs;
+        }
+
+        uint64_t sleepNs = isOn && nextPacketNs > now ? nextPacketNs - now : 1000000;
+        if (sleepNs > 1000000)
+            sleepNs = 1000000;  //stay responsive to commands
+        if (!isOn || nextPacketNs > now)
+            usleep(sleepNs / 1000);
+    }
+}
+
+void ofxOpenBCISimulator::handleCommand(unsigned char command)
+{
+    static const char* activate = "!@#$%^&*";
+
+    switch (command) {
+        case 'b': withAux = false; streaming.store(true); break;
+        case 'n': withAux = true; streaming.store(true); break;
+        case 's': streaming.store(false); break;
+        case 'F': filtersOn = true; break;
+        case 'f': filtersOn = false; break;
+        case '+': testSignal = true; break;
+        case 'v':
+            streaming.store(false);
+            sampleCounter = 0;
+            writeText("OpenBCI V3 Simulator\n$$$");
+            break;
+        case '?':
+            writeText(filtersOn ? "Filters on\n$$$" : "Filters off\n$$$");
+            break;
+        default:
+            if (command >= '1' && command <= '8') {
+                channelOn[command - '1'] = false;
+            } else if (command && strchr(activate, command)) {
+                int ch = strchr(activate, command) - activate;
+                channelOn[ch] = ch < settings.numChannels;
+            }
+            break;
+    }
+}
+
+void ofxOpenBCISimulator::writeText(const char* text)
+{
+    pending.insert(pending.end(), text, text + strlen(text));
+    flushPending();
+}
+
+//Writes as much of pending as the PTY takes, true once it's all out
+bool ofxOpenBCISimulator::flushPending()
+{
+    while (!pending.empty()) {
+        ssize_t written = write(masterFd, &pending[0], pending.size());
+        if (written <= 0)
+            return false;
+        pending.erase(pending.begin(), pending.begin() + written);
+    }
+    return true;
+}
+
+//Builds one packet, optionally mangles it and writes it to the PTY
+void ofxOpenBCISimulator::writePacket(uint64_t nowNs)
+{
+    unsigned char packet[OPENBCI_PACKET_LEN];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = OPENBCI_BYTE_START;
+    packet[1] = sampleCounter;
+    packet[OPENBCI_PACKET_LEN - 1] = OPENBCI_BYTE_END;
+
+    for (int ch = 0; ch < OPENBCI_NUM_CHANNELS; ch++) {
+        float uV = nextSample(ch);
+        int32_t counts = channelOn[ch] ? (int32_t)lrintf(uV / COUNT_TO_MICROVOLT) : 0;
+        if (counts > 0x7FFFFF) counts = 0x7FFFFF;
+        if (counts < -0x800000) counts = -0x800000;
+        unsigned char* dst = packet + 2 + 3 * ch;
+        dst[0] = (counts >> 16) & 0xFF;
+        dst[1] = (counts >> 8) & 0xFF;
+        dst[2] = counts & 0xFF;
+    }
+
+    if (withAux) {
+        //Board lying flat: 0, 0, +1g on the accelerometer
+        int16_t z = 1000;
+        packet[30] = (z >> 8) & 0xFF;
+        packet[31] = z & 0xFF;
+    }
+
+    unsigned char out[OPENBCI_PACKET_LEN * 2];
+    int len = 0;
+    for (int i = 0; i < OPENBCI_PACKET_LEN; i++) {
+        if (settings.corruptionRate > 0 && uniform() < settings.corruptionRate) {
+            if (uniform() < 0.5f)
+                continue;  //drop the byte
+            out[len++] = (unsigned char)(rng >> 8);  //replace it
+            continue;
+        }
+        out[len++] = packet[i];
+    }
+
+    //Only a packet that never started going out counts as dropped, once
+    //some of it is written the rest follows from pending
+    if (flushPending()) {
+        sendTimeNs[sampleCounter].store(nowNs);
+        pending.assign(out, out + len);
+        flushPending();
+        packetsSent.store(packetsSent.load() + 1);
+    } else {
+        packetsDropped.store(packetsDropped.load() + 1);  //nobody is reading fast enough
+    }
+
+    sampleCounter++;
+    sampleNumber++;
+}
+
+//Pink noise plus alpha and beta bursts that come and go, in microvolts
+float ofxOpenBCISimulator::nextSample(int channel)
+{
+    double t = sampleNumber / settings.sampleRate;
+    float dt = 1.f / settings.sampleRate;
+
+    if (testSignal)
+        return fmod(t, 1.0) < 0.5 ? TEST_SIGNAL_UV : -TEST_SIGNAL_UV;
+
+    //The burst envelopes are shared by all channels, update them once per packet
+    if (channel == 0) {
+        if (uniform() < BURSTS_PER_SECOND * dt)
+            alphaTarget = 1 - alphaTarget;
+        if (uniform() < BURSTS_PER_SECOND * dt)
+            betaTarget = 1 - betaTarget;
+        float k = dt / BURST_ATTACK_SECONDS;
+        alphaEnvelope += k * (alphaTarget - alphaEnvelope);
+        betaEnvelope += k * (betaTarget - betaEnvelope);
+    }
+
+    float white = gaussian();
+    float* b = pink[channel];
+    b[0] = 0.99886f * b[0] + white * 0.0555179f;
+    b[1] = 0.99332f * b[1] + white * 0.0750759f;
+    b[2] = 0.96900f * b[2] + white * 0.1538520f;
+    b[3] = 0.86650f * b[3] + white * 0.3104856f;
+    b[4] = 0.55000f * b[4] + white * 0.5329522f;
+    b[5] = -0.7616f * b[5] - white * 0.0168980f;
+    float pinkNoise = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + white * 0.5362f;
+    b[6] = white * 0.115926f;
+
+    float phase = 0.3f * channel;
+    float uV = PINK_NOISE_UV * pinkNoise
+             + ALPHA_UV * alphaEnvelope * sinf(2 * M_PI * 10 * t + phase)
+             + BETA_UV * betaEnvelope * sinf(2 * M_PI * 20 * t + phase);
+    if (!filtersOn)
+        uV += UNFILTERED_DC_UV * (channel + 1);
+    return uV;
+}
+
+//xorshift32, cheap and reproducible from the seed
+float ofxOpenBCISimulator::uniform()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng >> 8) * (1.f / 16777216.f);
+}
+
+float ofxOpenBCISimulator::gaussian()
+{
+    //Irwin-Hall with 4 terms is plenty for noise
+    return (uniform() + uniform() + uniform() + uniform() - 2.f) * 1.7320508f;
+}
@@ -0,0 +1,95 @@
+//
+//  ofxOpenBCISimulator.h
+//
+//  A virtual OpenBCI board on a pseudo-terminal, for testing without hardware.
+//  It answers the same single-byte commands as the real board ('b', 's', 'n',
+//  'F'/'f', '1'-'8' / '!'-'*', '+', 'v', '?') and streams correctly framed
+//  0xA0 ... 0xC0 packets of synthetic EEG at whatever rate you ask for. Point
+//  ofxOpenBCI or ofxOpenBCIHub at getPortName() as if it were /dev/tty.usb*.
+//
+//  Does not need openFrameworks, POSIX only.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ofxOpenBCIFramer.h"
+#include "ofxOpenBCIDecode.h"
+
+struct ofxOpenBCISimulatorSettings {
+    double sampleRate;       //packets per second, 250 is the real board
+    int numChannels;         //channels carrying signal, the rest read as 0
+    double corruptionRate;   //probability that any given byte is replaced or dropped
+    bool streamOnStart;      //behave as if 'b' was already sent
+    unsigned int seed;
+
+    ofxOpenBCISimulatorSettings():
+        sampleRate(250), numChannels(OPENBCI_NUM_CHANNELS), corruptionRate(0),
+        streamOnStart(false), seed(1) {}
+};
+
+class ofxOpenBCISimulator {
+public:
+    ofxOpenBCISimulator();
+    ~ofxOpenBCISimulator();
+
+    //Opens the PTY and starts the board thread. Returns false if the PTY
+    //could not be created.
+    bool start(const ofxOpenBCISimulatorSettings& settings);
+    void stop();
+
+    //Path of the slave side, e.g. /dev/pts/4 or /dev/ttys004
+    std::string getPortName() const { return portName; }
+
+    bool isStreaming() const { return streaming.load(); }
+    uint64_t getPacketsSent() const { return packetsSent.load(); }
+    uint64_t getPacketsDropped() const { return packetsDropped.load(); }
+
+    //When the packet carrying this sample counter was last written, in
+    //steady_clock nanoseconds. Used to measure end-to-end latency.
+    uint64_t getSendTimeNs(int sampleIndex) const { return sendTimeNs[sampleIndex & 0xFF].load(); }
+
+private:
+    void run();
+    void handleCommand(unsigned char command);
+    void writePacket(uint64_t nowNs);
+    void writeText(const char* text);
+    bool flushPending();
+    float nextSample(int channel);
+    float uniform();
+    float gaussian();
+
+    ofxOpenBCISimulatorSettings settings;
+    int masterFd;
+    int slaveFd;
+    std::string portName;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    //Bytes the PTY didn't take yet. They go out before anything else so a
+    //packet is never cut short, whatever a short write() leaves over.
+    std::vector<unsigned char> pending;
+
+    std::atomic<bool> streaming;
+    bool withAux;
+    bool filtersOn;
+    bool testSignal;
+    bool channelOn[OPENBCI_NUM_CHANNELS];
+    unsigned char sampleCounter;
+    uint64_t sampleNumber;
+
+    //Pink noise state per channel (Paul Kellet's filter) and the burst envelopes
+    float pink[OPENBCI_NUM_CHANNELS][7];
+    float alphaEnvelope, betaEnvelope;
+    float alphaTarget, betaTarget;
+    uint32_t rng;
+
+    std::atomic<uint64_t> packetsSent;
+    std::atomic<uint64_t> packetsDropped;
+    std::atomic<uint64_t> sendTimeNs[256];
+};
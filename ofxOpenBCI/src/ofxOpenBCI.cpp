@@ -20,14 +20,14 @@
 
 #include <algorithm>
 #include <time.h>
-#include <sys/time.h>
+#ifndef TARGET_WIN32
+#include <poll.h>
+#endif
 
 #include "ofxOpenBCI.h"
 
 #define byte char
 #define IS_MAC 1
-#define MAX_LEFTOVER_SERIAL_BYTES 200
-#define COUNT_TO_MICROVOLT .02232
 
 //Assuming most apps will run 30-60Hz, setting the counter to be 900 means that
 //If the app has looked for data for 30 seconds minutes without seeing anything, then the streaming needs
@@ -53,12 +53,10 @@ std::vector<string> command_activate_channel(command_activated_channel_initializ
 //This allows two OpenBCI units to be used in parallel
 string ofxOpenBCI::usedPort;
 
-ofxOpenBCI::ofxOpenBCI()
+ofxOpenBCI::ofxOpenBCI(): outputPacketBuffer(PACKET_RING_CAPACITY)
 {
     cout << "Trying to set it up...\n";
-    dataMode = DATAMODE_BIN;
-    missedCyclesCounter = 0;
-    curBuffIndex = 0;
+    init();
 
 
     //Loop through all available
@@ -88,6 +86,99 @@ ofxOpenBCI::ofxOpenBCI()
     }
 }
 
+//Connect to one known port rather than scanning, used by ofxOpenBCIHub
+ofxOpenBCI::ofxOpenBCI(const string& portName, int boardId): outputPacketBuffer(PACKET_RING_CAPACITY)
+{
+    init();
+    this->boardId = boardId;
+
+    if (serialDevice.setup(portName, OPENBCI_BAUDRATE)) {
+        ofLogNotice("ofxOpenBCI") << "Successfully setup " << portName;
+    } else {
+        ofLogNotice("ofxOpenBCI") << "Unable to setup " << portName;
+    }
+}
+
+void ofxOpenBCI::init()
+{
+    boardId = 0;
+    dataMode = DATAMODE_BIN;
+    missedCyclesCounter = 0;
+    readByHub = false;
+    hungUp.store(false);
+    daisyPendingValid = false;
+}
+
+bool ofxOpenBCI::connectionIsAlive()
+{
+    return serialDevice.isInitialized() && !hungUp.load();
+}
+
+ofxOpenBCI::~ofxOpenBCI()
+{
+    //The reader thread touches our members, so it has to be gone before they are
+    stopThreadedReading();
+}
+
+//Blocks until the serial port has bytes to read or the timeout expires.
+//Returns true if it is worth calling available()/readBytes().
+bool ofxOpenBCISerial::waitForData(int timeoutMillis)
+{
+#ifdef TARGET_WIN32
+    //No pollable descriptor for the COM handle, fall back to a short sleep
+    ofSleepMillis(1);
+    return true;
+#else
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, timeoutMillis) > 0 && (pfd.revents & POLLIN);
+#endif
+}
+
+int ofxOpenBCISerial::getDescriptor()
+{
+#ifdef TARGET_WIN32
+    return -1;
+#else
+    return isInitialized() ? fd : -1;
+#endif
+}
+
+//In threaded mode every board gets its own reader that sleeps on the serial
+//descriptor and parses packets as soon as they arrive, rather than once per
+//app frame. update() becomes a no-op and getData() drains what the thread parsed.
+void ofxOpenBCI::startThreadedReading()
+{
+    if (isThreadRunning() || readByHub)
+        return;
+    if (!serialDevice.isInitialized()) {
+        ofLogNotice("ofxOpenBCI") << "Not starting reader thread, serial device is not set up";
+        return;
+    }
+    startThread();
+}
+
+void ofxOpenBCI::stopThreadedReading()
+{
+    if (isThreadRunning())
+        waitForThread(true);
+}
+
+bool ofxOpenBCI::isThreadedReading()
+{
+    return isThreadRunning();
+}
+
+void ofxOpenBCI::threadedFunction()
+{
+    while (isThreadRunning()) {
+        if (serialDevice.waitForData(READER_POLL_MSEC))
+            readSerialBytes(false);
+    }
+}
+
 //ASSUMES A ONE CHARACTER INPUT!
 void ofxOpenBCI::sendSignalToBoard(string input)
 {
@@ -97,6 +188,21 @@ void ofxOpenBCI::sendSignalToBoard(string input)
     return;
 }
 
+//Pick how packets are decoded, see the DATAMODE_ constants. Set it before
+//startThreadedReading() since the reader uses it unlocked.
+void ofxOpenBCI::setDataMode(int mode)
+{
+    dataMode = mode;
+    daisyPendingValid = false;
+
+    //Two packets make one daisy sample, so the combined counter runs 0-127
+    int modulo = mode == DATAMODE_BIN_DAISY ? SAMPLE_INDEX_MODULO / 2 : SAMPLE_INDEX_MODULO;
+    gapTracker.setIndexModulo(modulo);
+    sampleClock.setIndexModulo(modulo);
+    gapTracker.reset();
+    sampleClock.reset();
+}
+
 //start the data transfer using the current mode
 void ofxOpenBCI::startStreaming()
 {
@@ -109,6 +215,10 @@ void ofxOpenBCI::startStreaming()
             sendSignalToBoard(command_startBinary);
             cout << "Processing: OpenBCI_ADS1299: starting binary\n";
             break;
+        case DATAMODE_BIN_DAISY:
+            sendSignalToBoard(command_startBinary);
+            cout << "Processing: OpenBCI_ADS1299: starting binary daisy\n";
+            break;
         case DATAMODE_BIN_WAUX:
             sendSignalToBoard(command_startBinary_wAux);
             cout << "Processing: OpenBCI_ADS1299: starting binary wAux\n";
@@ -151,98 +261,49 @@ void ofxOpenBCI::stopStreaming()
 //AT a sample rate of 250Hz we see about ~150 bytes per call of the update function
 void ofxOpenBCI::update(bool echoChar)
 {
-    struct timeval tv;
-    gettimeofday(&tv, 0);
+    //The reader thread (or the hub's) owns the serial port while it is running
+    if (isThreadRunning() || readByHub)
+        return;
+
+    readSerialBytes(echoChar);
+}
 
+//Everything below runs on whichever thread is the packet producer: the app
+//thread via update(), or the reader thread in threaded mode
+void ofxOpenBCI::readSerialBytes(bool echoChar)
+{
     if (!serialDevice.isInitialized())
         throw;
 
     int bytesAvailable = serialDevice.available();
-    if (bytesAvailable == -1)
-        return;
-
-    //First, see if there's anything in the leftover buffer and push into the currBuffer
-    curBuffIndex = 0;
-    currBuffer.clear();
-    currBuffer.resize(leftoverBytes.size());
-    for (unsigned i=0; i<leftoverBytes.size(); ++i) {
-        currBuffer[curBuffIndex++] = leftoverBytes[i];
-    }
-
-    //Then, get all bytes off the serial port
-    //printf("UPDATE START (%i) bytes: %dus\n",bytesAvailable, (int)tv.tv_usec);
-    uint8_t inByte_arrayBIG[bytesAvailable];
-    serialDevice.readBytes(inByte_arrayBIG, bytesAvailable);
-
-    currBuffer.resize(currBuffer.size()+bytesAvailable);
-    for (int i = 0; i<bytesAvailable; ++i) {
-        byte inByte = inByte_arrayBIG[i];
-
-        if (echoChar) //cout << inByte << " ";
-            printf("%02X ",inByte);
-
-        //accumulate the data in the buffer
-        currBuffer[curBuffIndex++] = inByte;
-
-    }//Finish the for loop around the input bytes
-
-    //If there was no data on the wire, then we're done
-    if (curBuffIndex == 0) {
-        //printf("No data on wire\n");
-        return;
-    }
-    curBuffIndex--; //Decrement to the last entered byte
 
-    //Roll back the pointer to the last end byte seen. Store any extra bytes between the end of the buffer
-    //and the last endIdx in the leftoverBytes array.
-    int lastPacketEndIdx = curBuffIndex;
-    while (currBuffer[lastPacketEndIdx] != BYTE_END) {
-        lastPacketEndIdx--;
-
-        //And if there's no complete packets in this data
-        if (lastPacketEndIdx < 0){
-            //cout << "No complete packets found of " << currBuffer.size() << "bytes\n";
-            break;
+    //Read straight into the framer's ring and parse whole packets in place.
+    //Whatever is left over (at most one partial packet) simply stays in the
+    //ring for next time, so no matter how much is pending nothing is dropped.
+    while (bytesAvailable > 0) {
+        size_t space;
+        unsigned char* dst = framer.writeSpan(space);
+        int bytesRead = serialDevice.readBytes(dst, min((size_t)bytesAvailable, space));
+        if (bytesRead <= 0)
+            return;
+
+        if (echoChar) {
+            for (int i = 0; i < bytesRead; ++i)
+                printf("%02X ", dst[i]);
         }
-    }
-//    printf("So lastPacketEndIdx points to a byte: %2X\n",currBuffer[lastPacketEndIdx]);
 
-    //Push the extra data into the leftOVerArray
-    leftoverBytes.clear();
-    leftoverBytes.resize(currBuffer.size()-lastPacketEndIdx-1);
-    for (unsigned i=lastPacketEndIdx+1; i<currBuffer.size(); ++i) {
-        leftoverBytes[i-lastPacketEndIdx-1] = currBuffer[i];
-    }
-//    printf("Left %i bytes in the leftover vector\n", leftoverBytes.size());
+        framer.commit(bytesRead);
+        bytesAvailable -= bytesRead;
 
-    //To avoid any compounding buffer issues, we set a max count in the lefover
-    //If it's too big we simply clear it
-    if (leftoverBytes.size() > MAX_LEFTOVER_SERIAL_BYTES) {
-        leftoverBytes.clear();
-    }
+        //Stamp as close to the read as we can, the clock spreads it over the packets
+        sampleClock.beginRead(ofxOpenBCINowNs());
 
-    //Process all the packets we know we have
-    //Go forward in the input array, from 0 the last end byte (that we found above)
-    unsigned nextIndexToTry = 0;
-    int tempResult = 0;
-    while ((int)nextIndexToTry < lastPacketEndIdx) {
-
-        if (currBuffer[nextIndexToTry] == BYTE_START) {
-            if (currBuffer.size() < 32 + nextIndexToTry)
-                return;//not enough samples
-            //If the message is succesfully created, nextIndexToTry is updated to be
-            tempResult = interpretBinaryMessageForward(nextIndexToTry);
-            if (tempResult==-1){ //No end byte was seen for that packet and packet's length byte
-                nextIndexToTry++;
-            } else {   //We have just processed a packet successfully
-                nextIndexToTry = tempResult;
-            }
-        } else {// if(currBuffer[nextIndexToTry]==BYTE_END){
-            nextIndexToTry++;
-        }
+        const unsigned char* packet;
+        while ((packet = framer.nextFrame()) != NULL)
+            interpretBinaryMessageForward(packet);
+
+        sampleClock.endRead();
     }
-    //printf("UPDATE END\n");
-    return;
 }
 
 //Takes the latest data out of the output queue and returns it as a vector
@@ -251,13 +312,17 @@ vector<dataPacket_ADS1299> ofxOpenBCI::getData()
     //To be returned in the function
     vector<dataPacket_ADS1299> output;
 
-    int currentSize = outputPacketBuffer.size();
-    output.resize(currentSize);
-
-    //printf("Sees %i objects in the outputPacketBuffer", currentSize);
-    for (int i = 0; i < currentSize; ++i) {
-        output[i] = outputPacketBuffer.front();
-        outputPacketBuffer.pop();
+    //Only drain what is there now, the reader thread may keep pushing behind us
+    size_t wanted = outputPacketBuffer.size();
+    output.reserve(wanted);
+
+    //At most two runs, one either side of the ring's wrap point
+    const dataPacket_ADS1299* packets;
+    size_t count;
+    while (output.size() < wanted && (count = peekData(packets)) > 0) {
+        count = std::min(count, wanted - output.size());
+        output.insert(output.end(), packets, packets + count);
+        releaseData(count);
     }
 
     if (output.size() == 0) {
@@ -271,10 +336,61 @@ vector<dataPacket_ADS1299> ofxOpenBCI::getData()
     return output;
 }
 
+size_t ofxOpenBCI::peekData(const dataPacket_ADS1299*& packets)
+{
+    return outputPacketBuffer.peek(packets);
+}
+
+void ofxOpenBCI::releaseData(size_t count)
+{
+    outputPacketBuffer.release(count);
+}
+
 //Accessor for to tell client that a new data packet has been parsed from the byte stream.
 bool ofxOpenBCI::isNewDataPacketAvailable()
 {
-    return outputPacketBuffer.size() > 0;
+    return !outputPacketBuffer.empty();
+}
+
+//Packets dropped because the app did not drain the ring in time
+size_t ofxOpenBCI::getPacketOverruns()
+{
+    return outputPacketBuffer.getOverruns();
+}
+
+//Most packets ever waiting in the ring at once
+size_t ofxOpenBCI::getPacketHighWaterMark()
+{
+    return outputPacketBuffer.getHighWaterMark();
+}
+
+size_t ofxOpenBCI::getPacketRingCapacity()
+{
+    return outputPacketBuffer.capacity();
+}
+
+//Start bytes that were not followed by an end byte where one was expected
+size_t ofxOpenBCI::getFramingErrors()
+{
+    return framer.getFramingErrors();
+}
+
+//How to treat holes in the sample counter, see ofxOpenBCIGapPolicy
+void ofxOpenBCI::setGapPolicy(ofxOpenBCIGapPolicy policy)
+{
+    gapTracker.setPolicy(policy);
+}
+
+//Set before startThreadedReading() for the same reason as the gap policy
+void ofxOpenBCI::setSampleRate(double sampleRate)
+{
+    sampleClock.setSampleRate(sampleRate);
+}
+
+//Lost/duplicated/out-of-order counts, cheap enough to poll every frame
+ofxOpenBCIStreamStats ofxOpenBCI::getStreamStats()
+{
+    return gapTracker.getStats();
 }
 
 //activate or deactivate an EEG channel...channel counting is zero through nchan-1
@@ -314,72 +430,85 @@ Bytes 31-32: Data value for accelerometer channel Z
 Byte 33: 0xC0
 */
 
-//Rewrote the interpretBinaryMessage fxn to avoid stumbling over a BYTE_END or BYTE_START on accident
-int ofxOpenBCI::interpretBinaryMessageForward(int startIdx)
+//The framer has already checked BYTE_START and BYTE_END, so this only decodes.
+//Each mode gets its own fully unrolled decoder, picked once per packet here.
+void ofxOpenBCI::interpretBinaryMessageForward(const unsigned char* packet)
 {
-    //assume curBuffIndex has already been incremented to the next starting spot
-    int endIdx = -1;
-    int nInt32 = 8;
-    unsigned char n_bytes = 32; //this is the number of bytes in the payload
-
-    if (currBuffer[startIdx] != BYTE_START)
-        throw;
-
-    //Counting forward, do we see the BYTE_END?
-    if (currBuffer[startIdx + n_bytes] != BYTE_END) {
-        printf("Bad packet: %i, %i. Got: %.02x \n", startIdx, endIdx, currBuffer[startIdx + n_bytes]);
-        return endIdx;
+    switch (dataMode) {
+        case DATAMODE_BIN_WAUX:
+            interpretLayout<ofxOpenBCILayoutBinaryAux>(packet);
+            break;
+        case DATAMODE_BIN_DAISY:
+            interpretDaisy(packet);
+            break;
+        case DATAMODE_TXT:
+            interpretTextMessage();
+            break;
+        default:
+            interpretLayout<ofxOpenBCILayoutBinary>(packet);
+            break;
     }
+}
 
-    endIdx = startIdx + n_bytes;
+//Full doc here: http://docs.openbci.com/05-OpenBCI_Streaming_Data_Format
+template <class Layout>
+void ofxOpenBCI::interpretLayout(const unsigned char* packet)
+{
+    dataPacket_ADS1299 dataPacket(Layout::numChannels);
+    ofxOpenBCIDecodeLayout<Layout>(packet, dataPacket.values.data(), dataPacket.auxValues);
+    dataPacket.hasAux = Layout::numAux > 0;
+    publishPacket(dataPacket, packet[1]); //rolling 0-255 counter
+}
 
-    dataPacket_ADS1299 dataPacket(nInt32);
-    dataPacket.timestamp = time(NULL);
-    dataPacket.sampleIndex = (int)currBuffer[startIdx+1];
+//With a daisy board attached the main board sends channels 1-8 on odd sample
+//numbers and the daisy sends 9-16 on the following even one. We hold the odd
+//half until its partner turns up and publish them as one 16 channel sample.
+void ofxOpenBCI::interpretDaisy(const unsigned char* packet)
+{
+    int sampleIndex = packet[1];
 
-    //Full doc here: http://docs.openbci.com/05-OpenBCI_Streaming_Data_Format
-    startIdx += 2;  //increment the start index
-    for (int i = 0; i < nInt32; i++) {
-        dataPacket.values[i] = interpret24bitAsInt32(&currBuffer[startIdx]);
-        startIdx += 3;  //increment the start index
+    if (sampleIndex & 1) {
+        daisyPending.clear(OPENBCI_MAX_CHANNELS);
+        ofxOpenBCIDecodeLayout<ofxOpenBCILayoutBinary>(packet, daisyPending.values.data(), daisyPending.auxValues);
+        daisyPending.sampleIndex = sampleIndex;
+        daisyPendingValid = true;
+        return;
     }
 
-    outputPacketBuffer.push(dataPacket);
+    //An even packet without its odd half in front of it can't be used
+    if (!daisyPendingValid || ((daisyPending.sampleIndex + 1) & 0xFF) != sampleIndex) {
+        daisyPendingValid = false;
+        return;
+    }
+    daisyPendingValid = false;
 
-    //printf("\n");
-    return endIdx;
+    float unusedAux[ofxOpenBCILayoutBinary::numAux + 1];
+    ofxOpenBCIDecodeLayout<ofxOpenBCILayoutBinary>(packet, daisyPending.values.data() + ofxOpenBCILayoutBinary::numChannels, unusedAux);
+    publishPacket(daisyPending, daisyPending.sampleIndex >> 1);
 }
 
-int ofxOpenBCI::interpret24bitAsInt32(byte byteArray[])
+//Stamps the decoded packet and hands it to the gap tracker, which pushes it
+//(and any fill) to the ring
+void ofxOpenBCI::publishPacket(dataPacket_ADS1299& dataPacket, int sampleIndex)
 {
-    int newInt = (
-        ((0xFF & byteArray[0]) << 16) |
-        ((0xFF & byteArray[1]) << 8) |
-        (0xFF & byteArray[2]));
-    if ((newInt & 0x00800000) > 0) {
-        newInt |= 0xFF000000;
-    } else {
-        newInt &= 0x00FFFFFF;
-    }
-    return newInt;
+    dataPacket.boardId = boardId;
+    dataPacket.sampleIndex = sampleIndex;
+    dataPacket.timestampNs = sampleClock.stamp(sampleIndex);
+    gapTracker.process(dataPacket, outputPacketBuffer);
 }
 
-int ofxOpenBCI::interpret16bitAsInt32(byte byteArray[])
+int ofxOpenBCI::interpret24bitAsInt32(const unsigned char byteArray[])
 {
-    int newInt = (
-        ((0xFF & byteArray[0]) << 8) |
-        (0xFF & byteArray[1]));
-    if ((newInt & 0x00008000) > 0) {
-        newInt |= 0xFFFF0000;
-    } else {
-        newInt &= 0x0000FFFF;
-    }
-    return newInt;
+    return ofxOpenBCIDecode24(byteArray);
+}
+
+int ofxOpenBCI::interpret16bitAsInt32(const unsigned char byteArray[])
+{
+    return ofxOpenBCIDecodeChannel<2>(byteArray);
 }
 
 int ofxOpenBCI::interpretTextMessage()
 {
     //still have to code this!
-    curBuffIndex=0;  //reset buffer counter back to zero to start refilling the buffer
     return 0;
 }
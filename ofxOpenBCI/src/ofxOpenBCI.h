@@ -6,9 +6,18 @@
 //
 //
 
+#pragma once
+
 #include <string.h>
+#include <type_traits>
 #include "ofMain.h"
 #include "ofSerial.h"
+#include "ofxOpenBCIRing.h"
+#include "ofxOpenBCIFramer.h"
+#include "ofxOpenBCIDecode.h"
+#include "ofxOpenBCIGapTracker.h"
+#include "ofxOpenBCIClock.h"
+#include "ofxOpenBCILayouts.h"
 
 #define OPENBCI_BAUDRATE 115200
 #define byte char
@@ -16,6 +25,7 @@
 const int DATAMODE_TXT = 0;
 const int DATAMODE_BIN_WAUX = 1;
 const int DATAMODE_BIN = 2;
+const int DATAMODE_BIN_DAISY = 3; //16 channels, the daisy board's packets interleaved with the main board's
 
 const int STATE_NOCOM = 0;
 const int STATE_COMINIT = 1;
@@ -28,15 +38,57 @@ const byte BYTE_START = byte(0xA0);
 const byte BYTE_END = byte(0xC0);
 const int LEN_SERIAL_BUFF_CHAR = 1000;
 const int MIN_PAYLOAD_LEN_INT32 = 1; //8 is the normal number, but there are shorter modes to enable Bluetooth
+const int PACKET_RING_CAPACITY = 1024; //~2 seconds at 500Hz, check getPacketHighWaterMark() before changing
+const int READER_POLL_MSEC = 100; //how long the reader thread blocks before checking if it should exit
+
+//Inline replacement for the vector<float> packets used to carry, so that code
+//reading values[i] or values.size() keeps working without a heap allocation
+template <int N>
+struct ofxOpenBCIChannels {
+    float v[N];
+    int count; //number of channels actually filled in, <= N
+
+    float& operator[](size_t i) { return v[i]; }
+    const float& operator[](size_t i) const { return v[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    float* data() { return v; }
+    const float* data() const { return v; }
+    float* begin() { return v; }
+    float* end() { return v + count; }
+    const float* begin() const { return v; }
+    const float* end() const { return v + count; }
+};
 
-struct dataPacket_ADS1299 {
-
-    vector<float> values;
+//One sample from the board. Everything is stored inline so packets can be
+//memcpy'd through the packet ring and getData() without touching the heap.
+template <int NCHAN>
+struct dataPacket_ADS1299T {
+    static const int MAX_CHANNELS = NCHAN;
+    static const int NUM_AUX = 3;
+
+    ofxOpenBCIChannels<NCHAN> values;
+    float auxValues[NUM_AUX]; //accelerometer X/Y/Z, only valid if hasAux
+    bool hasAux;
+    int boardId; //which board this came from when several are attached
     int sampleIndex;
-    time_t timestamp;
+    uint64_t timestampNs; //steady clock nanoseconds (ofxOpenBCINowNs), see ofxOpenBCISampleClock
 
-    dataPacket_ADS1299() {}
-    dataPacket_ADS1299(int nValues): values(nValues, 0){}
+    dataPacket_ADS1299T() { clear(NCHAN); }
+    dataPacket_ADS1299T(int nValues) { clear(nValues); }
+
+    void clear(int nValues)
+    {
+        values.count = nValues < NCHAN ? nValues : NCHAN;
+        for (int i=0; i < NCHAN; i++)
+            values.v[i] = 0;
+        for (int i=0; i < NUM_AUX; i++)
+            auxValues[i] = 0;
+        hasAux = false;
+        boardId = 0;
+        sampleIndex = 0;
+        timestampNs = 0;
+    }
 
     int printToConsole()
     {
@@ -49,7 +101,7 @@ struct dataPacket_ADS1299 {
         return 0;
     }
 
-    int copyTo(dataPacket_ADS1299& target)
+    int copyTo(dataPacket_ADS1299T& target)
     {
         target.sampleIndex = sampleIndex;
         for (unsigned i=0; i < values.size(); i++) {
@@ -59,6 +111,13 @@ struct dataPacket_ADS1299 {
     }
 };
 
+//Room for a daisy-chained pair of boards, values.size() says how many are in use
+const int OPENBCI_MAX_CHANNELS = 16;
+typedef dataPacket_ADS1299T<OPENBCI_MAX_CHANNELS> dataPacket_ADS1299;
+
+static_assert(std::is_trivially_copyable<dataPacket_ADS1299>::value,
+              "dataPacket_ADS1299 must stay trivially copyable to move through the packet ring");
+
 
 class filterConstants {
 public:
@@ -68,24 +127,57 @@ public:
     filterConstants(const std::vector<double> & b_given, const std::vector<double> & a_given, const string & name_given): b(b_given), a(a_given), name(name_given){}
 };
 
+//ofSerial keeps its file descriptor protected, this exposes just enough of it
+//for the reader thread to sleep until bytes arrive instead of spinning
+class ofxOpenBCISerial : public ofSerial {
+public:
+    bool waitForData(int timeoutMillis);
+    int getDescriptor(); //-1 where there is no pollable descriptor (Windows)
+};
+
 //--------------This is the OpenBCI OpenFrameworks code ------------------//
-class ofxOpenBCI {
+class ofxOpenBCI : public ofThread {
 public:
     ofxOpenBCI();
+    ofxOpenBCI(const string& portName, int boardId = 0);
+    ~ofxOpenBCI();
     void init();
     void update(bool echoChar);
+    void startThreadedReading();
+    void stopThreadedReading();
+    bool isThreadedReading();
     void toggleFilter(bool turnOn);
     void triggerTestSignal(bool turnOn);
     void changeChannelState(unsigned Ichan,bool activate);
     void startStreaming();
     void stopStreaming();
     void sendSignalToBoard(string input);
+    void setDataMode(int mode); //use this rather than writing dataMode, daisy mode changes the counter
     bool connectionIsAlive();
     bool isNewDataPacketAvailable();
-    int interpretBinaryMessageForward(int endInd);
+    void interpretBinaryMessageForward(const unsigned char* packet);
     vector<dataPacket_ADS1299> getData();
 
-    ofSerial serialDevice;
+    //Zero-copy draining: packets points at the oldest parsed packets and the
+    //return value says how many are contiguous there (0 when there are none).
+    //They stay valid until releaseData(); call both until peekData() returns 0.
+    size_t peekData(const dataPacket_ADS1299*& packets);
+    void releaseData(size_t count);
+
+    size_t getPacketOverruns();
+    size_t getPacketHighWaterMark();
+    size_t getPacketRingCapacity();
+    size_t getFramingErrors();
+
+    //Set before startThreadedReading(), the reader thread reads it unlocked
+    void setGapPolicy(ofxOpenBCIGapPolicy policy);
+    ofxOpenBCIStreamStats getStreamStats();
+
+    //Nominal rate used to spread timestamps over packets that arrive together
+    void setSampleRate(double sampleRate);
+
+    ofxOpenBCISerial serialDevice;
+    int boardId;
     int dataMode;
     static string usedPort;
     bool filterApplied;
@@ -93,13 +185,29 @@ public:
     int missedCyclesCounter;
     vector<bool> enabledChannels;
 
+protected:
+    void threadedFunction();
+
 private:
+    //The hub polls many boards from its own thread and calls readSerialBytes directly
+    friend class ofxOpenBCIHub;
+    bool readByHub;
+    std::atomic<bool> hungUp; //set by the hub when poll() reports the device gone
+
+    void readSerialBytes(bool echoChar);
+    template <class Layout> void interpretLayout(const unsigned char* packet);
+    void interpretDaisy(const unsigned char* packet);
+    void publishPacket(dataPacket_ADS1299& dataPacket, int sampleIndex);
     int interpretTextMessage();
-    int interpret24bitAsInt32(byte byteArray[]);
-    int interpret16bitAsInt32(byte byteArray[]);
+    int interpret24bitAsInt32(const unsigned char byteArray[]);
+    int interpret16bitAsInt32(const unsigned char byteArray[]);
+
+    ofxOpenBCIFramer framer;
+    ofxOpenBCIGapTracker<dataPacket_ADS1299> gapTracker;
+    ofxOpenBCISampleClock sampleClock;
 
-    int curBuffIndex;
-    vector<byte> leftoverBytes;
-    vector<byte> currBuffer;
-    queue<dataPacket_ADS1299> outputPacketBuffer;
+    //Daisy mode: the main board's half of a sample, waiting for the daisy's half
+    dataPacket_ADS1299 daisyPending;
+    bool daisyPendingValid;
+    ofxOpenBCIRing<dataPacket_ADS1299> outputPacketBuffer;
 };
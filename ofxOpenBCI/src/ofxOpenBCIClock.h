@@ -0,0 +1,100 @@
+//
+//  ofxOpenBCIClock.h
+//
+//  Per-sample timestamps for packets that arrive in bursts. A single read()
+//  often completes many packets at once, so stamping each one with the time
+//  of the read would make them look simultaneous. Instead every packet gets
+//      offset + sampleNumber * period
+//  where period comes from the nominal sample rate and offset is fitted
+//  against the read times: each read gives an upper bound for the last packet
+//  it completed, offset follows the lowest of those bounds straight away and
+//  creeps up slowly, which soaks up the board's crystal drifting against ours.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+const double OPENBCI_SAMPLE_RATE = 250.0;  //what the board streams at out of the box
+const double CLOCK_DRIFT_GAIN = 0.01;      //how quickly offset may move later, per read
+
+//Monotonic nanoseconds, same clock as std::chrono::steady_clock
+inline uint64_t ofxOpenBCINowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ofxOpenBCISampleClock {
+public:
+    ofxOpenBCISampleClock(double sampleRate = OPENBCI_SAMPLE_RATE)
+    {
+        setSampleRate(sampleRate);
+        indexModulo = 256;
+        reset();
+    }
+
+    void setSampleRate(double sampleRate) { periodNs = 1e9 / sampleRate; }
+    void setIndexModulo(int modulo) { indexModulo = modulo; }
+    double getSampleRate() const { return 1e9 / periodNs; }
+
+    void reset()
+    {
+        started = false;
+        stampedThisRead = false;
+        sampleNumber = 0;
+        lastIndex = 0;
+        offsetNs = 0;
+        readNs = 0;
+    }
+
+    //Call right after read() returns, before stamping the packets it completed
+    void beginRead(uint64_t nowNs)
+    {
+        readNs = nowNs;
+        stampedThisRead = false;
+    }
+
+    //Timestamp for the next packet, given its rolling sample counter
+    uint64_t stamp(int sampleIndex)
+    {
+        if (!started) {
+            started = true;
+            offsetNs = (double)readNs;
+        } else {
+            //Step by the counter so dropped packets don't squash the timeline.
+            //Anything odd (duplicates, going backwards) counts as one sample.
+            int delta = (sampleIndex - lastIndex + indexModulo) % indexModulo;
+            sampleNumber += (delta >= 1 && delta <= indexModulo / 2) ? delta : 1;
+        }
+        lastIndex = sampleIndex;
+        stampedThisRead = true;
+
+        double t = offsetNs + sampleNumber * periodNs;
+        return t > (double)readNs ? readNs : (uint64_t)t;
+    }
+
+    //Call once all packets from this read have been stamped
+    void endRead()
+    {
+        if (!stampedThisRead)
+            return;
+
+        double candidate = (double)readNs - sampleNumber * periodNs;
+        if (candidate < offsetNs)
+            offsetNs = candidate;
+        else
+            offsetNs += CLOCK_DRIFT_GAIN * (candidate - offsetNs);
+    }
+
+private:
+    double periodNs;
+    double offsetNs;
+    uint64_t readNs;
+    uint64_t sampleNumber;
+    int lastIndex;
+    int indexModulo;
+    bool started;
+    bool stampedThisRead;
+};
@@ -0,0 +1,122 @@
+//
+//  ofxOpenBCIDecode.cpp
+//
+
+#include "ofxOpenBCIDecode.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+void ofxOpenBCIDecodeFramesScalar(const unsigned char* frames, size_t nFrames,
+                                  float* out, size_t outStride, float scale)
+{
+    for (size_t i = 0; i < nFrames; i++) {
+        const unsigned char* payload = frames + i * OPENBCI_PACKET_LEN + 2;
+        for (int ch = 0; ch < OPENBCI_NUM_CHANNELS; ch++)
+            out[ch * outStride + i] = ofxOpenBCIDecode24(payload + 3 * ch) * scale;
+    }
+}
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+//Moves 4 packed 3-byte big-endian samples into the top 3 bytes of 4 int32
+//lanes (lowest byte zeroed), so an arithmetic shift right by 8 sign extends.
+static inline __m128i decodeShuffleMask()
+{
+    return _mm_setr_epi8(-1, 2, 1, 0,  -1, 5, 4, 3,  -1, 8, 7, 6,  -1, 11, 10, 9);
+}
+#endif
+
+#if defined(__AVX2__)
+//8 packets per iteration: one 256-bit register holds all 8 channels of a
+//packet (channels 0-3 in the low lane, 4-7 in the high lane), then an 8x8
+//transpose turns packets-by-channels into channels-by-packets.
+void ofxOpenBCIDecodeFrames(const unsigned char* frames, size_t nFrames,
+                            float* out, size_t outStride, float scale)
+{
+    const __m256i shuffle = _mm256_broadcastsi128_si256(decodeShuffleMask());
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+
+    for (; i + 8 <= nFrames; i += 8) {
+        __m256 r[8];
+        for (int f = 0; f < 8; f++) {
+            const unsigned char* payload = frames + (i + f) * OPENBCI_PACKET_LEN + 2;
+            __m128i lo = _mm_loadu_si128((const __m128i*)payload);        //channels 0-3
+            __m128i hi = _mm_loadu_si128((const __m128i*)(payload + 12)); //channels 4-7
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuffle), 8);
+            r[f] = _mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale);
+        }
+
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+        __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+        _mm256_storeu_ps(out + 0 * outStride + i, _mm256_permute2f128_ps(s0, s4, 0x20));
+        _mm256_storeu_ps(out + 1 * outStride + i, _mm256_permute2f128_ps(s1, s5, 0x20));
+        _mm256_storeu_ps(out + 2 * outStride + i, _mm256_permute2f128_ps(s2, s6, 0x20));
+        _mm256_storeu_ps(out + 3 * outStride + i, _mm256_permute2f128_ps(s3, s7, 0x20));
+        _mm256_storeu_ps(out + 4 * outStride + i, _mm256_permute2f128_ps(s0, s4, 0x31));
+        _mm256_storeu_ps(out + 5 * outStride + i, _mm256_permute2f128_ps(s1, s5, 0x31));
+        _mm256_storeu_ps(out + 6 * outStride + i, _mm256_permute2f128_ps(s2, s6, 0x31));
+        _mm256_storeu_ps(out + 7 * outStride + i, _mm256_permute2f128_ps(s3, s7, 0x31));
+    }
+
+    ofxOpenBCIDecodeFramesScalar(frames + i * OPENBCI_PACKET_LEN, nFrames - i, out + i, outStride, scale);
+}
+
+#elif defined(__SSSE3__)
+//4 packets per iteration: two 128-bit registers per packet (channels 0-3 and
+//4-7), then two 4x4 transposes.
+void ofxOpenBCIDecodeFrames(const unsigned char* frames, size_t nFrames,
+                            float* out, size_t outStride, float scale)
+{
+    const __m128i shuffle = decodeShuffleMask();
+    const __m128 vscale = _mm_set1_ps(scale);
+    size_t i = 0;
+
+    for (; i + 4 <= nFrames; i += 4) {
+        __m128 lo[4], hi[4];
+        for (int f = 0; f < 4; f++) {
+            const unsigned char* payload = frames + (i + f) * OPENBCI_PACKET_LEN + 2;
+            __m128i a = _mm_loadu_si128((const __m128i*)payload);
+            __m128i b = _mm_loadu_si128((const __m128i*)(payload + 12));
+            a = _mm_srai_epi32(_mm_shuffle_epi8(a, shuffle), 8);
+            b = _mm_srai_epi32(_mm_shuffle_epi8(b, shuffle), 8);
+            lo[f] = _mm_mul_ps(_mm_cvtepi32_ps(a), vscale);
+            hi[f] = _mm_mul_ps(_mm_cvtepi32_ps(b), vscale);
+        }
+
+        _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+        _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+        for (int ch = 0; ch < 4; ch++) {
+            _mm_storeu_ps(out + ch * outStride + i, lo[ch]);
+            _mm_storeu_ps(out + (ch + 4) * outStride + i, hi[ch]);
+        }
+    }
+
+    ofxOpenBCIDecodeFramesScalar(frames + i * OPENBCI_PACKET_LEN, nFrames - i, out + i, outStride, scale);
+}
+
+#else
+void ofxOpenBCIDecodeFrames(const unsigned char* frames, size_t nFrames,
+                            float* out, size_t outStride, float scale)
+{
+    ofxOpenBCIDecodeFramesScalar(frames, nFrames, out, outStride, scale);
+}
+#endif
@@ -0,0 +1,40 @@
+//
+//  ofxOpenBCIDecode.h
+//
+//  Batch decoding of validated OpenBCI packets into microvolts.
+//  Each packet carries eight 24-bit big-endian two's complement samples at
+//  bytes 2..25. The batch decoder unpacks, sign extends and scales many
+//  packets at once and writes them channel-major, which is the layout the
+//  filters and FFTs want.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ofxOpenBCIFramer.h"
+
+const int OPENBCI_NUM_CHANNELS = 8;
+const float COUNT_TO_MICROVOLT = 0.02232f; //ADS1299 LSB at gain 24, roughly 4.5V / 24 / 2^23
+const int32_t ADS1299_MAX_COUNT = 8388607;  //2^23 - 1, where a saturated channel sits
+
+//Sign extend one 24-bit big-endian sample without a branch
+inline int32_t ofxOpenBCIDecode24(const unsigned char* b)
+{
+    return (int32_t)(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8)) >> 8;
+}
+
+//Decode nFrames packets laid out back to back (OPENBCI_PACKET_LEN bytes each,
+//framing already checked) into out, channel-major:
+//    out[ch * outStride + i] = channel ch of packet i, times scale
+//outStride must be >= nFrames. Uses AVX2 or SSSE3 when the compiler targets
+//them (-mavx2 / -mssse3, the default on OS X), otherwise plain C++.
+void ofxOpenBCIDecodeFrames(const unsigned char* frames, size_t nFrames,
+                            float* out, size_t outStride,
+                            float scale = COUNT_TO_MICROVOLT);
+
+//Plain C++ version of the above, always available. Used for the tail of a
+//batch and as the reference the SIMD paths are checked against.
+void ofxOpenBCIDecodeFramesScalar(const unsigned char* frames, size_t nFrames,
+                                  float* out, size_t outStride,
+                                  float scale = COUNT_TO_MICROVOLT);
@@ -0,0 +1,70 @@
+//
+//  ofxOpenBCIFramer.cpp
+//
+
+#include "ofxOpenBCIFramer.h"
+
+ofxOpenBCIFramer::ofxOpenBCIFramer(size_t capacity)
+{
+    size_t pow2 = OPENBCI_PACKET_LEN;
+    while (pow2 & (pow2 - 1))
+        pow2++;
+    while (pow2 < capacity)
+        pow2 <<= 1;
+    ring.resize(pow2);
+    mask = pow2 - 1;
+    reset();
+}
+
+void ofxOpenBCIFramer::reset()
+{
+    readPos = 0;
+    writePos = 0;
+    framingErrors.store(0, std::memory_order_relaxed);
+}
+
+unsigned char* ofxOpenBCIFramer::writeSpan(size_t& space)
+{
+    size_t freeBytes = ring.size() - pending();
+    size_t offset = writePos & mask;
+    size_t untilWrap = ring.size() - offset;
+    space = freeBytes < untilWrap ? freeBytes : untilWrap;
+    return &ring[offset];
+}
+
+void ofxOpenBCIFramer::commit(size_t nBytes)
+{
+    writePos += nBytes;
+}
+
+//Scans forward from the oldest unparsed byte. Anything that is not a start
+//byte is skipped, a start byte without an end byte 32 bytes later counts as a
+//framing error and we resync on the very next byte. We never look backward.
+const unsigned char* ofxOpenBCIFramer::nextFrame()
+{
+    while (readPos != writePos) {
+        if (at(readPos) != OPENBCI_BYTE_START) {
+            readPos++;
+            continue;
+        }
+
+        if (pending() < (size_t)OPENBCI_PACKET_LEN)
+            return NULL; //wait for the rest of this packet
+
+        if (at(readPos + OPENBCI_PACKET_LEN - 1) != OPENBCI_BYTE_END) {
+            framingErrors.store(framingErrors.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            readPos++;
+            continue;
+        }
+
+        size_t offset = readPos & mask;
+        readPos += OPENBCI_PACKET_LEN;
+        if (offset + OPENBCI_PACKET_LEN <= ring.size())
+            return &ring[offset];
+
+        for (int i = 0; i < OPENBCI_PACKET_LEN; i++)
+            scratch[i] = ring[(offset + i) & mask];
+        return scratch;
+    }
+    return NULL;
+}
@@ -0,0 +1,50 @@
+//
+//  ofxOpenBCIFramer.h
+//
+//  Persistent byte ring plus a forward-only state machine that finds
+//  0xA0 ... 0xC0 packets in the raw serial stream. Bytes are read from the
+//  serial device straight into the ring and frames are handed back in place,
+//  so each byte is copied once no matter how far behind the reader is.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+
+const int OPENBCI_PACKET_LEN = 33; //start byte, sample index, 31 payload bytes, end byte
+const unsigned char OPENBCI_BYTE_START = 0xA0;
+const unsigned char OPENBCI_BYTE_END = 0xC0;
+const size_t FRAMER_RING_CAPACITY = 4096;
+
+class ofxOpenBCIFramer {
+public:
+    ofxOpenBCIFramer(size_t capacity = FRAMER_RING_CAPACITY);
+
+    //Contiguous free space the caller may write into directly, followed by
+    //commit() with the number of bytes actually written
+    unsigned char* writeSpan(size_t& space);
+    void commit(size_t nBytes);
+
+    //Returns the next complete packet (OPENBCI_PACKET_LEN bytes, starting at
+    //BYTE_START) or NULL if more bytes are needed. The pointer stays valid
+    //until the next call to nextFrame() or commit().
+    const unsigned char* nextFrame();
+
+    void reset();
+    size_t pending() const { return writePos - readPos; }
+    size_t getFramingErrors() const { return framingErrors.load(std::memory_order_relaxed); }
+
+private:
+    unsigned char at(size_t pos) const { return ring[pos & mask]; }
+
+    std::vector<unsigned char> ring;
+    size_t mask;
+    size_t readPos;  //both positions only ever grow, masked on access
+    size_t writePos;
+    std::atomic<size_t> framingErrors; //written by the reader thread, read by the app
+
+    //Frames that straddle the end of the ring are gathered here
+    unsigned char scratch[OPENBCI_PACKET_LEN];
+};
@@ -0,0 +1,159 @@
+//
+//  ofxOpenBCIGapTracker.h
+//
+//  Watches the board's rolling 0-255 sample counter for lost, duplicated and
+//  out-of-order packets, and optionally synthesizes the missing samples so
+//  that downstream windows always contain the number of samples they expect.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+enum ofxOpenBCIGapPolicy {
+    GAP_DROP,        //pass packets through as they come, gaps stay gaps
+    GAP_HOLD_LAST,   //repeat the last good packet for every missing sample
+    GAP_INTERPOLATE  //linearly interpolate between the packets either side of the gap
+};
+
+//Snapshot of the counters, see ofxOpenBCIGapTracker::getStats()
+struct ofxOpenBCIStreamStats {
+    size_t received;    //packets that made it through framing
+    size_t lost;        //samples missing from the counter sequence
+    size_t duplicated;  //packets repeating the previous counter, dropped
+    size_t outOfOrder;  //packets whose counter went backwards, dropped
+    size_t filled;      //packets synthesized by the gap policy
+};
+
+const int SAMPLE_INDEX_MODULO = 256;  //daisy-chained boards pair packets up, so their counter wraps at 128
+const int MAX_OUT_OF_ORDER_RUN = 3;  //after this many in a row assume the board restarted its counter
+
+template <class Packet>
+class ofxOpenBCIGapTracker {
+public:
+    ofxOpenBCIGapTracker(): policy(GAP_DROP), indexModulo(SAMPLE_INDEX_MODULO)
+    {
+        reset();
+        received.store(0);
+        lost.store(0);
+        duplicated.store(0);
+        outOfOrder.store(0);
+        filled.store(0);
+    }
+
+    //Where sampleIndex wraps around. Any jump of more than half of this is
+    //read as the counter going backwards.
+    void setIndexModulo(int modulo) { indexModulo = modulo; }
+
+    void setPolicy(ofxOpenBCIGapPolicy newPolicy) { policy = newPolicy; }
+    ofxOpenBCIGapPolicy getPolicy() const { return policy; }
+
+    //Producer side only. Forgets the last packet but keeps the counters.
+    void reset()
+    {
+        hasLast = false;
+        outOfOrderRun = 0;
+    }
+
+    //Producer side. Checks the packet's counter against the previous one and
+    //pushes it (plus any filler packets, oldest first) into sink, which only
+    //needs a push(const Packet&) method.
+    template <class Sink>
+    void process(const Packet& packet, Sink& sink)
+    {
+        bump(received);
+
+        if (!hasLast) {
+            accept(packet, sink);
+            return;
+        }
+
+        int delta = (packet.sampleIndex - last.sampleIndex + indexModulo) % indexModulo;
+
+        if (delta == 0) {
+            bump(duplicated);
+            return;
+        }
+
+        if (delta > indexModulo / 2) {
+            bump(outOfOrder);
+            if (++outOfOrderRun < MAX_OUT_OF_ORDER_RUN)
+                return;
+            //The counter has been going "backwards" for too long, take the
+            //new sequence as the truth rather than dropping everything
+            accept(packet, sink);
+            return;
+        }
+
+        int missing = delta - 1;
+        if (missing > 0) {
+            add(lost, missing);
+            if (policy != GAP_DROP) {
+                fill(packet, missing, sink);
+                add(filled, missing);
+            }
+        }
+        accept(packet, sink);
+    }
+
+    //Safe to call from any thread, costs a handful of relaxed loads
+    ofxOpenBCIStreamStats getStats() const
+    {
+        ofxOpenBCIStreamStats stats;
+        stats.received = received.load(std::memory_order_relaxed);
+        stats.lost = lost.load(std::memory_order_relaxed);
+        stats.duplicated = duplicated.load(std::memory_order_relaxed);
+        stats.outOfOrder = outOfOrder.load(std::memory_order_relaxed);
+        stats.filled = filled.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    template <class Sink>
+    void accept(const Packet& packet, Sink& sink)
+    {
+        last = packet;
+        hasLast = true;
+        outOfOrderRun = 0;
+        sink.push(packet);
+    }
+
+    template <class Sink>
+    void fill(const Packet& next, int missing, Sink& sink)
+    {
+        Packet filler = last;
+        for (int k = 1; k <= missing; k++) {
+            float t = (float)k / (missing + 1);
+            filler.sampleIndex = (last.sampleIndex + k) % indexModulo;
+            filler.timestampNs = last.timestampNs + (int64_t)(t * (int64_t)(next.timestampNs - last.timestampNs));
+            if (policy == GAP_INTERPOLATE) {
+                for (size_t ch = 0; ch < filler.values.size(); ch++)
+                    filler.values[ch] = last.values[ch] + t * (next.values[ch] - last.values[ch]);
+                for (int a = 0; a < Packet::NUM_AUX; a++)
+                    filler.auxValues[a] = last.auxValues[a] + t * (next.auxValues[a] - last.auxValues[a]);
+            }
+            sink.push(filler);
+        }
+    }
+
+    //Only the producer writes the counters, so no read-modify-write is needed
+    static void bump(std::atomic<size_t>& counter) { add(counter, 1); }
+    static void add(std::atomic<size_t>& counter, size_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    ofxOpenBCIGapPolicy policy;
+    int indexModulo;
+    Packet last;
+    bool hasLast;
+    int outOfOrderRun;
+
+    std::atomic<size_t> received;
+    std::atomic<size_t> lost;
+    std::atomic<size_t> duplicated;
+    std::atomic<size_t> outOfOrder;
+    std::atomic<size_t> filled;
+};
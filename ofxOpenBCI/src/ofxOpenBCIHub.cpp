@@ -0,0 +1,169 @@
+//
+//  ofxOpenBCIHub.cpp
+//
+
+#include "ofxOpenBCIHub.h"
+
+#ifndef TARGET_WIN32
+#include <poll.h>
+#endif
+
+ofxOpenBCIHub::ofxOpenBCIHub()
+{
+}
+
+ofxOpenBCIHub::~ofxOpenBCIHub()
+{
+    close();
+}
+
+int ofxOpenBCIHub::setup(int maxBoards)
+{
+    close();
+
+    //One scan for everybody, rather than one per ofxOpenBCI constructor
+    ofSerial scanner;
+    std::vector<ofSerialDeviceInfo> devicesInfo = scanner.getDeviceList();
+
+    for (std::size_t i = 0; i < devicesInfo.size() && (int)boards.size() < maxBoards; ++i) {
+        cout << "Trying to connect to: " << devicesInfo[i].getDeviceName() << "\n";
+        addBoard(devicesInfo[i].getDeviceName());
+    }
+    return boards.size();
+}
+
+int ofxOpenBCIHub::setup(const vector<string>& portNames)
+{
+    close();
+
+    for (std::size_t i = 0; i < portNames.size(); ++i)
+        addBoard(portNames[i]);
+    return boards.size();
+}
+
+//Board ids are handed out in the order boards are opened, starting at 0
+void ofxOpenBCIHub::addBoard(const string& portName)
+{
+    ofxOpenBCI* board = new ofxOpenBCI(portName, boards.size());
+    if (!board->serialDevice.isInitialized()) {
+        delete board;
+        return;
+    }
+    board->readByHub = true;
+    boards.push_back(board);
+}
+
+void ofxOpenBCIHub::close()
+{
+    stop();
+    for (std::size_t i = 0; i < boards.size(); ++i)
+        delete boards[i];
+    boards.clear();
+}
+
+void ofxOpenBCIHub::start()
+{
+    if (!isThreadRunning() && !boards.empty())
+        startThread();
+}
+
+void ofxOpenBCIHub::stop()
+{
+    if (isThreadRunning())
+        waitForThread(true);
+}
+
+void ofxOpenBCIHub::threadedFunction()
+{
+#ifdef TARGET_WIN32
+    //No poll() on COM handles, so just sweep the boards
+    while (isThreadRunning()) {
+        for (std::size_t i = 0; i < boards.size(); ++i)
+            boards[i]->readSerialBytes(false);
+        ofSleepMillis(1);
+    }
+#else
+    //The board list cannot change while we run (setup() stops the thread first)
+    vector<struct pollfd> pollSet(boards.size());
+    for (std::size_t i = 0; i < boards.size(); ++i) {
+        pollSet[i].fd = boards[i]->serialDevice.getDescriptor();
+        pollSet[i].events = POLLIN;
+    }
+
+    while (isThreadRunning()) {
+        for (std::size_t i = 0; i < pollSet.size(); ++i)
+            pollSet[i].revents = 0;
+
+        if (poll(&pollSet[0], pollSet.size(), READER_POLL_MSEC) <= 0)
+            continue;
+
+        for (std::size_t i = 0; i < pollSet.size(); ++i) {
+            if (pollSet[i].revents & POLLIN)
+                boards[i]->readSerialBytes(false);
+
+            //An unplugged dongle reports these on every call, stop polling it
+            //or the thread spins
+            if (pollSet[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+                ofLogError("ofxOpenBCIHub") << "Board " << i << " disconnected";
+                pollSet[i].fd = -1;
+                boards[i]->hungUp.store(true);
+            }
+        }
+    }
+#endif
+}
+
+int ofxOpenBCIHub::getNumBoards()
+{
+    return boards.size();
+}
+
+ofxOpenBCI& ofxOpenBCIHub::getBoard(int boardId)
+{
+    return *boards[boardId];
+}
+
+vector<dataPacket_ADS1299> ofxOpenBCIHub::getData(int boardId)
+{
+    return boards[boardId]->getData();
+}
+
+size_t ofxOpenBCIHub::peekData(int boardId, const dataPacket_ADS1299*& packets)
+{
+    return boards[boardId]->peekData(packets);
+}
+
+void ofxOpenBCIHub::releaseData(int boardId, size_t count)
+{
+    boards[boardId]->releaseData(count);
+}
+
+void ofxOpenBCIHub::startStreaming()
+{
+    for (std::size_t i = 0; i < boards.size(); ++i)
+        boards[i]->startStreaming();
+}
+
+void ofxOpenBCIHub::stopStreaming()
+{
+    for (std::size_t i = 0; i < boards.size(); ++i)
+        boards[i]->stopStreaming();
+}
+
+void ofxOpenBCIHub::toggleFilter(bool turnOn)
+{
+    for (std::size_t i = 0; i < boards.size(); ++i)
+        boards[i]->toggleFilter(turnOn);
+}
+
+void ofxOpenBCIHub::setGapPolicy(ofxOpenBCIGapPolicy policy)
+{
+    for (std::size_t i = 0; i < boards.size(); ++i)
+        boards[i]->setGapPolicy(policy);
+}
+
+void ofxOpenBCIHub::setSampleRate(double sampleRate)
+{
+    for (std::size_t i = 0; i < boards.size(); ++i)
+        boards[i]->setSampleRate(sampleRate);
+}
@@ -0,0 +1,53 @@
+//
+//  ofxOpenBCIHub.h
+//
+//  Runs any number of OpenBCI boards from a single I/O thread. The hub scans
+//  the serial devices once, opens every board it finds and then sleeps in one
+//  poll() over all of their descriptors, parsing whichever boards have bytes
+//  waiting. Each board still publishes into its own packet ring, so the app
+//  drains them with getData(boardId) exactly like a single ofxOpenBCI.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOpenBCI.h"
+
+const int MAX_HUB_BOARDS = 8;
+
+class ofxOpenBCIHub : public ofThread {
+public:
+    ofxOpenBCIHub();
+    ~ofxOpenBCIHub();
+
+    //Open up to maxBoards of the serial devices that are present, or exactly
+    //the ports given. Returns how many boards were opened.
+    int setup(int maxBoards = MAX_HUB_BOARDS);
+    int setup(const vector<string>& portNames);
+
+    //Start/stop the shared I/O thread
+    void start();
+    void stop();
+
+    int getNumBoards();
+    ofxOpenBCI& getBoard(int boardId);
+    vector<dataPacket_ADS1299> getData(int boardId);
+    size_t peekData(int boardId, const dataPacket_ADS1299*& packets);
+    void releaseData(int boardId, size_t count);
+
+    //Convenience wrappers that send the same command to every board
+    void startStreaming();
+    void stopStreaming();
+    void toggleFilter(bool turnOn);
+    void setGapPolicy(ofxOpenBCIGapPolicy policy);
+    void setSampleRate(double sampleRate);
+
+protected:
+    void threadedFunction();
+
+private:
+    void addBoard(const string& portName);
+    void close();
+
+    vector<ofxOpenBCI*> boards;
+};
@@ -0,0 +1,59 @@
+//
+//  ofxOpenBCILayouts.h
+//
+//  Compile-time description of what sits between the sample counter and the
+//  end byte of a packet: how many channels, how many 16-bit aux words, and
+//  whether channels are 24- or 16-bit. Decoding against a layout type lets
+//  the compiler fully unroll the loops for each mode, so adding aux or daisy
+//  support costs the plain 8-channel path nothing.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include "ofxOpenBCIFramer.h"
+#include "ofxOpenBCIDecode.h"
+
+template <int NCHAN, int NAUX, int BYTES_PER_CHANNEL>
+struct ofxOpenBCIFrameLayout {
+    static const int numChannels = NCHAN;
+    static const int numAux = NAUX;
+    static const int bytesPerChannel = BYTES_PER_CHANNEL;
+    static const int auxOffset = 2 + NCHAN * BYTES_PER_CHANNEL;
+
+    static_assert(BYTES_PER_CHANNEL == 2 || BYTES_PER_CHANNEL == 3, "channels are 16 or 24 bit");
+    static_assert(auxOffset + 2 * NAUX <= OPENBCI_PACKET_LEN - 1, "payload does not fit in a packet");
+};
+
+//The layouts the board actually sends
+typedef ofxOpenBCIFrameLayout<8, 0, 3> ofxOpenBCILayoutBinary;     //'b'
+typedef ofxOpenBCIFrameLayout<8, 3, 3> ofxOpenBCILayoutBinaryAux;  //'n', accelerometer X/Y/Z at bytes 26-31
+
+template <int BYTES>
+inline int32_t ofxOpenBCIDecodeChannel(const unsigned char* b);
+
+template <>
+inline int32_t ofxOpenBCIDecodeChannel<3>(const unsigned char* b)
+{
+    return ofxOpenBCIDecode24(b);
+}
+
+template <>
+inline int32_t ofxOpenBCIDecodeChannel<2>(const unsigned char* b)
+{
+    return (int16_t)((b[0] << 8) | b[1]);
+}
+
+//Decodes one packet's channels into values[0..numChannels) and its aux words
+//into aux[0..numAux). Values are raw ADC counts, as they have always been.
+template <class Layout>
+inline void ofxOpenBCIDecodeLayout(const unsigned char* packet, float* values, float* aux)
+{
+    const unsigned char* src = packet + 2;
+    for (int ch = 0; ch < Layout::numChannels; ch++)
+        values[ch] = (float)ofxOpenBCIDecodeChannel<Layout::bytesPerChannel>(src + ch * Layout::bytesPerChannel);
+
+    src = packet + Layout::auxOffset;
+    for (int a = 0; a < Layout::numAux; a++)
+        aux[a] = (float)ofxOpenBCIDecodeChannel<2>(src + 2 * a);
+}
@@ -0,0 +1,113 @@
+//
+//  ofxOpenBCIRing.h
+//
+//  Fixed-capacity, lock-free single-producer/single-consumer ring.
+//  One thread (the serial reader) pushes, one thread (the app) pops.
+//  Neither side ever blocks or allocates once the ring is constructed, and the
+//  consumer can read batches in place with peek()/release().
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+template <class T>
+class ofxOpenBCIRing {
+public:
+    //capacity is rounded up to the next power of two so indices can be masked
+    explicit ofxOpenBCIRing(size_t capacity)
+    {
+        size_t pow2 = 1;
+        while (pow2 < capacity)
+            pow2 <<= 1;
+        slots.resize(pow2);
+        mask = pow2 - 1;
+        head.store(0);
+        tail.store(0);
+        overruns.store(0);
+        highWater.store(0);
+    }
+
+    //Producer side. Returns false (and counts an overrun) if the consumer
+    //has fallen a full ring behind; the new element is dropped in that case.
+    bool push(const T& value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t used = h - tail.load(std::memory_order_acquire);
+        if (used > mask) {
+            overruns.store(overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[h & mask] = value;
+        head.store(h + 1, std::memory_order_release);
+
+        //Only the producer writes these counters, so a plain store is enough
+        if (used + 1 > highWater.load(std::memory_order_relaxed))
+            highWater.store(used + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //Consumer side. Returns false when there is nothing to read.
+    bool pop(T& value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        value = slots[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Consumer side, zero-copy alternative to pop(). Points first at the oldest
+    //unread element and returns how many follow it contiguously, which is less
+    //than size() when the data wraps the end of the ring. The producer can't
+    //reuse those slots until release() hands them back, so read them in place.
+    size_t peek(const T*& first) const
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t used = head.load(std::memory_order_acquire) - t;
+        size_t toEnd = capacity() - (t & mask);
+        first = &slots[t & mask];
+        return used < toEnd ? used : toEnd;
+    }
+
+    //Consumer side. Gives the first count peeked elements back to the producer.
+    void release(size_t count)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    //Safe to call from either side, the answer may be stale by the time it is used
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return mask + 1; }
+
+    //Number of elements dropped because the ring was full
+    size_t getOverruns() const { return overruns.load(std::memory_order_relaxed); }
+
+    //Largest occupancy the producer has seen, use this to size the ring
+    size_t getHighWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+
+private:
+    ofxOpenBCIRing(const ofxOpenBCIRing&);
+    ofxOpenBCIRing& operator=(const ofxOpenBCIRing&);
+
+    std::vector<T> slots;
+    size_t mask;
+
+    //Keep the producer and consumer indices on separate cache lines. Padding
+    //rather than alignas so owners can still be created with plain new.
+    char padBefore[64];
+    std::atomic<size_t> head;
+    char padHead[64];
+    std::atomic<size_t> tail;
+    char padTail[64];
+    std::atomic<size_t> overruns;
+    std::atomic<size_t> highWater;
+};